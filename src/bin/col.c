@@ -5,6 +5,9 @@
 
 typedef struct _Color Color;
 
+/* bumped whenever a palette gets set */
+static unsigned int _generation = 0;
+
 struct _Color
 {
    unsigned char r;
@@ -387,6 +390,7 @@ colors_term_init(Evas_Object *textgrid, Evas_Object *bg, Config *config)
    int r, g , b, a;
    const Color *color;
 
+   _generation++;
    for (c = 0; c < (4 * 12); c++)
      {
         n = c + (24 * (c / 24));
@@ -473,3 +477,122 @@ colors_standard_get(int set, int col,
    *b = 0;
    *a = 0;
 }
+
+/* sets one palette entry of the textgrid after the terminal got set up,
+ * so that the colors cached from it get looked up again */
+void
+colors_palette_set(Evas_Object *textgrid, Evas_Textgrid_Palette pal,
+                   int idx, int r, int g, int b, int a)
+{
+   _generation++;
+   evas_object_textgrid_palette_set(textgrid, pal, idx, r, g, b, a);
+}
+
+unsigned int
+colors_generation_get(void)
+{
+   return _generation;
+}
+
+/* {{{ Cell colors
+ *
+ * The color of one side of a cell only depends on its color, whether it
+ * is from the extended palette, whether it is intense and whether the
+ * cell ends up inverted, so both sides are looked up in a table indexed
+ * by those bits.  What is left per cell is swapping both sides of
+ * inverted cells and adding the bold or faint offset, without branching
+ * on the colors themselves.
+ */
+
+#define COLOR_KEY(Col, Ext, Intense, Inv) \
+   ((Col) | ((Ext) << 8) | ((Intense) << 9) | ((Inv) << 10))
+#define COLOR_KEYS (1 << 11)
+
+static unsigned char _fg_lut[COLOR_KEYS];
+static unsigned char _bg_lut[COLOR_KEYS];
+static Eina_Bool _lut_done = EINA_FALSE;
+/* indexed by bold | faint << 1 */
+static const unsigned char _style_add[4] = { 0, 12, 24, 36 };
+
+static void
+_lut_init(void)
+{
+   int key;
+
+   for (key = 0; key < COLOR_KEYS; key++)
+     {
+        int col = key & 0xff;
+        int ext = (key >> 8) & 1;
+        int intense = (key >> 9) & 1;
+        int inv = (key >> 10) & 1;
+        int fg = col, bg = col;
+
+        if ((fg == COL_DEF) && (inv)) fg = COL_INVERSEBG;
+        if (bg == COL_DEF)
+          {
+             if (inv) bg = COL_INVERSE;
+             else if (!ext) bg = COL_INVIS;
+          }
+        if ((intense) && (!ext))
+          {
+             fg += 48;
+             bg += 48;
+          }
+        _fg_lut[key] = fg;
+        _bg_lut[key] = bg;
+     }
+   _lut_done = EINA_TRUE;
+}
+
+/* colors of the w cells, with reverse set for a reversed screen */
+void
+colors_row_get(const Termcell *cells, int w, Eina_Bool reverse,
+               Color_Pair *out)
+{
+   unsigned int rev = !!reverse;
+   int x;
+
+   if (!_lut_done) _lut_init();
+   for (x = 0; x < w; x++)
+     {
+        const Termatt *att = &(cells[x].att);
+        unsigned int inv = att->inverse ^ rev;
+        unsigned char fg, bg, fgext, bgext, t;
+
+        fg = _fg_lut[COLOR_KEY(att->fg, att->fg256, att->fgintense, inv)];
+        bg = _bg_lut[COLOR_KEY(att->bg, att->bg256, att->bgintense, inv)];
+        fgext = att->fg256;
+        bgext = att->bg256;
+        if (inv)
+          {
+             t = fg; fg = bg; bg = t;
+             t = fgext; fgext = bgext; bgext = t;
+          }
+        if (!fgext) fg += _style_add[att->bold | (att->faint << 1)];
+        out[x].fg = fg;
+        out[x].bg = bg;
+        out[x].fg_ext = fgext;
+        out[x].bg_ext = bgext;
+     }
+}
+
+/* the one color a cell of colors col is reduced to in the miniview, as
+ * an entry of the standard palette or 256 + one of the extended one, or
+ * -1 if it shows nothing */
+int
+colors_cell_minimap_get(const Termcell *cell, const Color_Pair *col)
+{
+   Eina_Unicode codepoint = cell->codepoint;
+
+   if ((codepoint == 0) || (cell->att.newline) || (cell->att.invisible))
+     return -1;
+   if (col->bg_ext)
+     return col->bg + 256;
+   if ((col->bg) && ((col->bg % 12) != COL_INVIS))
+     return col->bg;
+   if ((codepoint > 32) && (codepoint < 0x00110000))
+     return col->fg + (col->fg_ext ? 256 : 0);
+   return -1;
+}
+
+/* }}} */
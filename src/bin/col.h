@@ -3,8 +3,22 @@
 
 #include <Evas.h>
 #include "config.h"
+#include "termpty.h"
+
+typedef struct _Color_Pair Color_Pair;
+
+/* textgrid colors of a cell, ext telling to use the extended palette */
+struct _Color_Pair
+{
+   unsigned char fg, bg;
+   unsigned char fg_ext, bg_ext;
+};
 
 void colors_term_init(Evas_Object *textgrid, Evas_Object *bg, Config *config);
 void colors_standard_get(int set, int col, unsigned char *r, unsigned char *g, unsigned char *b, unsigned char *a);
+void colors_palette_set(Evas_Object *textgrid, Evas_Textgrid_Palette pal, int idx, int r, int g, int b, int a);
+unsigned int colors_generation_get(void);
+void colors_row_get(const Termcell *cells, int w, Eina_Bool reverse, Color_Pair *out);
+int colors_cell_minimap_get(const Termcell *cell, const Color_Pair *col);
 
 #endif
@@ -7,13 +7,14 @@
 #include "col.h"
 #include "utils.h"
 
-#define CONF_VER 6
+#define CONF_VER 10
 
 #define LIM(v, min, max) {if (v >= max) v = max; else if (v <= min) v = min;}
 
 static Eet_Data_Descriptor *edd_base = NULL;
 static Eet_Data_Descriptor *edd_color = NULL;
 static Eet_Data_Descriptor *edd_keys = NULL;
+static Eet_Data_Descriptor *edd_links = NULL;
 
 static const char *
 _config_home_get(void)
@@ -74,6 +75,15 @@ config_init(void)
    EET_DATA_DESCRIPTOR_ADD_BASIC
      (edd_keys, Config_Keys, "cb", cb, EET_T_STRING);
 
+   eet_eina_stream_data_descriptor_class_set
+     (&eddc, sizeof(eddc), "Config_Link", sizeof(Config_Link));
+   edd_links = eet_data_descriptor_stream_new(&eddc);
+
+   EET_DATA_DESCRIPTOR_ADD_BASIC
+     (edd_links, Config_Link, "pattern", pattern, EET_T_STRING);
+   EET_DATA_DESCRIPTOR_ADD_BASIC
+     (edd_links, Config_Link, "url", url, EET_T_STRING);
+
    EET_DATA_DESCRIPTOR_ADD_BASIC
      (edd_base, Config, "version", version, EET_T_INT);
    EET_DATA_DESCRIPTOR_ADD_BASIC
@@ -104,10 +114,14 @@ config_init(void)
      (edd_base, Config, "background", background, EET_T_STRING);
    EET_DATA_DESCRIPTOR_ADD_BASIC
      (edd_base, Config, "scrollback", scrollback, EET_T_INT);
+   EET_DATA_DESCRIPTOR_ADD_BASIC
+     (edd_base, Config, "scrollback_budget", scrollback_budget, EET_T_INT);
    EET_DATA_DESCRIPTOR_ADD_BASIC
      (edd_base, Config, "tab_zoom", tab_zoom, EET_T_DOUBLE);
    EET_DATA_DESCRIPTOR_ADD_BASIC
      (edd_base, Config, "vidmod", vidmod, EET_T_INT);
+   EET_DATA_DESCRIPTOR_ADD_BASIC
+     (edd_base, Config, "media_cache", media_cache, EET_T_INT);
    EET_DATA_DESCRIPTOR_ADD_BASIC
      (edd_base, Config, "jump_on_change", jump_on_change, EET_T_UCHAR);
    EET_DATA_DESCRIPTOR_ADD_BASIC
@@ -157,6 +171,8 @@ config_init(void)
      (edd_base, Config, "bell_rings", bell_rings, EET_T_UCHAR);
    EET_DATA_DESCRIPTOR_ADD_LIST
      (edd_base, Config, "keys", keys, edd_keys);
+   EET_DATA_DESCRIPTOR_ADD_LIST
+     (edd_base, Config, "links", links, edd_links);
    EET_DATA_DESCRIPTOR_ADD_BASIC
      (edd_base, Config, "gravatar", gravatar, EET_T_UCHAR);
    EET_DATA_DESCRIPTOR_ADD_BASIC
@@ -165,6 +181,10 @@ config_init(void)
      (edd_base, Config, "mv_always_show", mv_always_show, EET_T_UCHAR);
    EET_DATA_DESCRIPTOR_ADD_BASIC
      (edd_base, Config, "ty_escapes", ty_escapes, EET_T_UCHAR);
+   EET_DATA_DESCRIPTOR_ADD_BASIC
+     (edd_base, Config, "snapshot_on_exit", snapshot_on_exit, EET_T_UCHAR);
+   EET_DATA_DESCRIPTOR_ADD_BASIC
+     (edd_base, Config, "scrollback_index", scrollback_index, EET_T_UCHAR);
 }
 
 void
@@ -180,6 +200,11 @@ config_shutdown(void)
         eet_data_descriptor_free(edd_color);
         edd_color = NULL;
      }
+   if (edd_links)
+     {
+        eet_data_descriptor_free(edd_links);
+        edd_links = NULL;
+     }
    efreet_shutdown();
 }
 
@@ -220,6 +245,36 @@ config_save(Config *config, const char *key)
    main_config_sync(config);
 }
 
+static void
+_links_free(Config *config)
+{
+   Config_Link *link;
+
+   EINA_LIST_FREE(config->links, link)
+     {
+        eina_stringshare_del(link->pattern);
+        eina_stringshare_del(link->url);
+        free(link);
+     }
+}
+
+static void
+_links_copy(const Config *config_src, Config *config)
+{
+   const Config_Link *link;
+   const Eina_List *l;
+
+   EINA_LIST_FOREACH(config_src->links, l, link)
+     {
+        Config_Link *link2 = calloc(1, sizeof(Config_Link));
+
+        if (!link2) break;
+        link2->pattern = eina_stringshare_ref(link->pattern);
+        link2->url = eina_stringshare_ref(link->url);
+        config->links = eina_list_append(config->links, link2);
+     }
+}
+
 void
 config_sync(const Config *config_src, Config *config)
 {
@@ -237,8 +292,10 @@ config_sync(const Config *config_src, Config *config)
    eina_stringshare_replace(&(config->helper.local.image), config_src->helper.local.image);
    eina_stringshare_replace(&(config->theme), config_src->theme);
    config->scrollback = config_src->scrollback;
+   config->scrollback_budget = config_src->scrollback_budget;
    config->tab_zoom = config_src->tab_zoom;
    config->vidmod = config_src->vidmod;
+   config->media_cache = config_src->media_cache;
    config->jump_on_keypress = config_src->jump_on_keypress;
    config->jump_on_change = config_src->jump_on_change;
    config->flicker_on_key = config_src->flicker_on_key;
@@ -261,10 +318,14 @@ config_sync(const Config *config_src, Config *config)
    memcpy(config->colors, config_src->colors, sizeof(config->colors));
    config->mouse_over_focus = config_src->mouse_over_focus;
    /* TODO: config->keys */
+   _links_free(config);
+   _links_copy(config_src, config);
    config->gravatar = config_src->gravatar;
    config->notabs = config_src->notabs;
    config->mv_always_show = config_src->mv_always_show;
    config->ty_escapes = config_src->ty_escapes;
+   config->snapshot_on_exit = config_src->snapshot_on_exit;
+   config->scrollback_index = config_src->scrollback_index;
 }
 
 static void
@@ -479,7 +540,19 @@ config_load(const char *key)
                 case 5:
                   config->ty_escapes = EINA_TRUE;
                   /*pass through*/
-                case CONF_VER: /* 6 */
+                case 6:
+                  config->scrollback_budget = 0;
+                  /*pass through*/
+                case 7:
+                  config->snapshot_on_exit = EINA_FALSE;
+                  /*pass through*/
+                case 8:
+                  config->scrollback_index = EINA_FALSE;
+                  /*pass through*/
+                case 9:
+                  config->media_cache = 32;
+                  /*pass through*/
+                case CONF_VER: /* 10 */
                   config->version = CONF_VER;
                   break;
                 default:
@@ -514,10 +587,12 @@ config_load(const char *key)
              config->helper.local.image = eina_stringshare_add("xdg-open");
              config->helper.inline_please = EINA_TRUE;
              config->scrollback = 2000;
+             config->scrollback_budget = 0;
              config->theme = eina_stringshare_add("default.edj");
              config->background = NULL;
              config->tab_zoom = 0.5;
              config->vidmod = 0;
+             config->media_cache = 32;
              config->opacity = 50;
              config->cg_width = 80;
              config->cg_height = 24;
@@ -544,6 +619,7 @@ config_load(const char *key)
              config->notabs = EINA_FALSE;
              config->mv_always_show = EINA_FALSE;
              config->ty_escapes = EINA_TRUE;
+             config->snapshot_on_exit = EINA_FALSE;
              for (j = 0; j < 4; j++)
                {
                   for (i = 0; i < 12; i++)
@@ -606,8 +682,10 @@ config_fork(Config *config)
    SCPY(theme);
    SCPY(background);
    CPY(scrollback);
+   CPY(scrollback_budget);
    CPY(tab_zoom);
    CPY(vidmod);
+   CPY(media_cache);
    CPY(jump_on_change);
    CPY(jump_on_keypress);
    CPY(flicker_on_key);
@@ -637,6 +715,8 @@ config_fork(Config *config)
    CPY(notabs);
    CPY(mv_always_show);
    CPY(ty_escapes);
+   CPY(snapshot_on_exit);
+   CPY(scrollback_index);
 
    EINA_LIST_FOREACH(config->keys, l, key)
      {
@@ -651,6 +731,7 @@ config_fork(Config *config)
         eina_stringshare_ref(key->cb);
         config2->keys = eina_list_append(config2->keys, key2);
      }
+   _links_copy(config, config2);
 
    return config2;
 }
@@ -682,6 +763,7 @@ config_del(Config *config)
         eina_stringshare_del(key->cb);
         free(key);
      }
+   _links_free(config);
    free(config);
 }
 
@@ -6,6 +6,7 @@
 typedef struct _Config Config;
 typedef struct _Config_Color Config_Color;
 typedef struct _Config_Keys Config_Keys;
+typedef struct _Config_Link Config_Link;
 
 struct _Config_Keys
 {
@@ -18,6 +19,14 @@ struct _Config_Keys
    Eina_Bool hyper;
    const char *cb;
 };
+
+/* text matching the extended regex pattern is a link to url, where every
+ * %s is replaced by that text.  Without url, the text is the link */
+struct _Config_Link
+{
+   const char *pattern;
+   const char *url;
+};
 /* TODO: separate config per terminal (tab, window) and global. */
 
 struct _Config_Color
@@ -29,6 +38,7 @@ struct _Config
 {
    int               version;
    int               scrollback;
+   int               scrollback_budget; /* in MiB, shared by all terms */
    struct {
       const char    *name;
       const char    *orig_name; /* not in EET */
@@ -50,6 +60,7 @@ struct _Config
    const char       *background;
    double            tab_zoom;
    int               vidmod;
+   int               media_cache; /* in MiB per term, for hidden media */
    int               opacity;
    int               cg_width;
    int               cg_height;
@@ -76,8 +87,11 @@ struct _Config
    Eina_Bool         notabs;
    Eina_Bool         mv_always_show;
    Eina_Bool         ty_escapes;
+   Eina_Bool         snapshot_on_exit;
+   Eina_Bool         scrollback_index;
    Config_Color      colors[(4 * 12)];
    Eina_List        *keys;
+   Eina_List        *links;
 
    Eina_Bool         temporary; /* not in EET */
    Eina_Bool         font_set; /* not in EET */
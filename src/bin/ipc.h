@@ -17,6 +17,7 @@ struct _Ipc_Instance
    const char *font;
    const char *startup_id;
    const char *startup_split;
+   const char *restore;
    int x, y, w, h;
    int pos;
    int login_shell;
@@ -9,23 +9,16 @@
 #include "keyin.h"
 
 typedef struct _Tty_Key Tty_Key;
-typedef struct _Key_Values Key_Values;
 
 struct _s {
     char *s;
     ssize_t len;
 };
 
-struct _Key_Values {
-    struct _s plain;
-    struct _s alt;
-    struct _s ctrl;
-    struct _s ctrl_alt;
-    struct _s shift;
-    struct _s shift_alt;
-    struct _s shift_ctrl;
-    struct _s shift_ctrl_alt;
-};
+/* indexed by alt | ctrl << 1 | shift << 2: plain, alt, ctrl, ctrl_alt,
+ * shift, shift_alt, shift_ctrl, shift_ctrl_alt */
+typedef struct _s Key_Values[8];
+
 struct _Tty_Key
 {
     char *key;
@@ -55,36 +48,15 @@ static Eina_Hash *_key_bindings = NULL;
 
 /* {{{ Keys to TTY */
 
-static Eina_Bool
-_key_try(Termpty *ty, const Tty_Key *map, int len, const Evas_Event_Key_Down *ev,
-         int alt, int shift, int ctrl)
+static void
+_key_try(Termpty *ty, const Tty_Key *key, int alt, int shift, int ctrl)
 {
-   int i, inlen;
+   const struct _s *kv, *s;
 
-   inlen = strlen(ev->key);
-   for (i = 0; i < len; i++)
-     {
-        if ((inlen == map[i].key_len) && (!memcmp(ev->key, map[i].key, inlen)))
-          {
-             const struct _s *s = NULL;
-             const Key_Values *kv;
-
-             if (!ty->termstate.appcursor) kv = &map[i].default_mode;
-             else                          kv = &map[i].cursor;
-             if (!alt && !ctrl && !shift)     s = &kv->plain;
-             else if (alt && !ctrl && !shift) s = &kv->alt;
-             else if (!alt && ctrl && !shift) s = &kv->ctrl;
-             else if (alt && ctrl && !shift)  s = &kv->ctrl_alt;
-             else if (!alt && !ctrl && shift) s = &kv->shift;
-             else if (alt && !ctrl && shift)  s = &kv->shift_alt;
-             else if (!alt && ctrl && shift)  s = &kv->shift_ctrl;
-             else if (alt && ctrl && shift)   s = &kv->shift_ctrl_alt;
-
-             if (s) termpty_write(ty, s->s, s->len);
-             return EINA_TRUE;
-          }
-     }
-   return EINA_FALSE;
+   if (!ty->termstate.appcursor) kv = key->default_mode;
+   else                          kv = key->cursor;
+   s = &kv[(!!alt) | ((!!ctrl) << 1) | ((!!shift) << 2)];
+   if (s->len > 0) termpty_write(ty, s->s, s->len);
 }
 
 /* }}} */
@@ -105,6 +77,8 @@ static void
 _handle_key_to_pty(Termpty *ty, const Evas_Event_Key_Down *ev,
                    int alt, int shift, int ctrl)
 {
+   int i;
+
    if (!ev->key)
      return;
 
@@ -146,30 +120,30 @@ _handle_key_to_pty(Termpty *ty, const Evas_Event_Key_Down *ev,
              return;
           }
      }
-   if (ev->key[0] == 'K' && ev->key[1] == 'k')
+   if (ev->key[0] == 'K' && ev->key[1] == 'P')
      {
         if (!evas_key_lock_is_set(ev->locks, "Num_Lock"))
           {
-             if (ty->termstate.alt_kp)
-               {
-                  if (_key_try(ty, tty_keys_kp_app,
-                               sizeof(tty_keys_kp_app)/sizeof(tty_keys_kp_app[0]),
-                               ev, alt, shift, ctrl))
-                    return;
-               }
-             else
+             i = tty_keys_kp_index(ev->key, strlen(ev->key));
+             if (i >= 0)
                {
-                  if (_key_try(ty, tty_keys_kp_plain,
-                               sizeof(tty_keys_kp_plain)/sizeof(tty_keys_kp_plain[0]),
-                               ev, alt, shift, ctrl))
-                    return;
+                  if (ty->termstate.alt_kp)
+                    _key_try(ty, &tty_keys_kp_app[i], alt, shift, ctrl);
+                  else
+                    _key_try(ty, &tty_keys_kp_plain[i], alt, shift, ctrl);
+                  return;
                }
           }
      }
    else
-     if (_key_try(ty, tty_keys, sizeof(tty_keys)/sizeof(tty_keys[0]), ev,
-                  alt, shift, ctrl))
-       return;
+     {
+        i = tty_keys_index(ev->key, strlen(ev->key));
+        if (i >= 0)
+          {
+             _key_try(ty, &tty_keys[i], alt, shift, ctrl);
+             return;
+          }
+     }
 
    if (ctrl)
      {
@@ -559,6 +533,54 @@ cb_scroll_down_line(Evas_Object *term)
    return EINA_TRUE;
 }
 
+static Eina_Bool
+cb_snapshot_save(Evas_Object *term)
+{
+   return termio_snapshot_save(term, NULL);
+}
+
+static Eina_Bool
+cb_scrollback_save(Evas_Object *term)
+{
+   return termio_scrollback_save(term, NULL, TERMIO_EXPORT_TEXT);
+}
+
+static Eina_Bool
+cb_scrollback_save_ansi(Evas_Object *term)
+{
+   return termio_scrollback_save(term, NULL, TERMIO_EXPORT_ANSI);
+}
+
+static Eina_Bool
+cb_scrollback_save_html(Evas_Object *term)
+{
+   return termio_scrollback_save(term, NULL, TERMIO_EXPORT_HTML);
+}
+
+static Eina_Bool
+cb_search_next(Evas_Object *term)
+{
+   return termio_search_next(term, EINA_FALSE);
+}
+
+static Eina_Bool
+cb_search_prev(Evas_Object *term)
+{
+   return termio_search_next(term, EINA_TRUE);
+}
+
+static Eina_Bool
+cb_search_cancel(Evas_Object *term)
+{
+   return termio_search_cancel(term);
+}
+
+static Eina_Bool
+cb_filter_toggle(Evas_Object *term)
+{
+   return termio_filter_toggle(term);
+}
+
 
 static Shortcut_Action _actions[] =
 {
@@ -567,6 +589,10 @@ static Shortcut_Action _actions[] =
      {"one_page_down", gettext_noop("Scroll one page down"), cb_scroll_down_page},
      {"one_line_up", gettext_noop("Scroll one line up"), cb_scroll_up_line},
      {"one_line_down", gettext_noop("Scroll one line down"), cb_scroll_down_line},
+     {"search_next", gettext_noop("Jump to the next search match"), cb_search_next},
+     {"search_prev", gettext_noop("Jump to the previous search match"), cb_search_prev},
+     {"search_cancel", gettext_noop("Stop the running search"), cb_search_cancel},
+     {"filter_toggle", gettext_noop("Switch between the filtered and the full view"), cb_filter_toggle},
 
      {"group", gettext_noop("Copy/Paste"), NULL},
      {"copy_primary", gettext_noop("Copy selection to Primary buffer"), cb_copy_primary},
@@ -603,6 +629,10 @@ static Shortcut_Action _actions[] =
      {"win_fullscreen", gettext_noop("Toggle Fullscreen of the window"), cb_win_fullscreen},
      {"miniview", gettext_noop("Display the history miniview"), cb_miniview},
      {"cmd_box", gettext_noop("Display the command box"), cb_cmd_box},
+     {"snapshot_save", gettext_noop("Save screen and scrollback to a file"), cb_snapshot_save},
+     {"scrollback_save", gettext_noop("Save the text of the scrollback to a file"), cb_scrollback_save},
+     {"scrollback_save_ansi", gettext_noop("Save the scrollback with its colors as ANSI text"), cb_scrollback_save_ansi},
+     {"scrollback_save_html", gettext_noop("Save the scrollback with its colors as HTML"), cb_scrollback_save_html},
 
      {NULL, NULL, NULL}
 };
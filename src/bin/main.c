@@ -295,6 +295,9 @@ main_ipc_new(Ipc_Instance *inst)
    if (win_term_set(wn, term) < 0)
      return;
 
+   if (inst->restore)
+     termio_snapshot_restore(term_termio_get(term), inst->restore);
+
    main_trans_update(config);
    main_media_update(config);
    if (inst->pos)
@@ -358,6 +361,8 @@ static Ecore_Getopt options = {
                               " 'v' for vertical and 'h' for horizontal."
                               " Can be used multiple times. eg -S vhvv or --split hv"
                               " More description available on the man page.")),
+      ECORE_GETOPT_STORE_STR ('\0', "restore",
+                              gettext_noop("Restore screen and scrollback from a snapshot file.")),
       ECORE_GETOPT_CHOICE    ('v', "video-module",
                               gettext_noop("Set emotion module to use."), emotion_choices),
 
@@ -451,6 +456,7 @@ elm_main(int argc, char **argv)
    char *icon_name = NULL;
    char *font = NULL;
    char *startup_split = NULL;
+   char *restore = NULL;
    char *video_module = NULL;
    Eina_Bool login_shell = 0xff; /* unset */
    Eina_Bool video_mute = 0xff; /* unset */
@@ -486,6 +492,7 @@ elm_main(int argc, char **argv)
      ECORE_GETOPT_VALUE_STR(icon_name),
      ECORE_GETOPT_VALUE_STR(font),
      ECORE_GETOPT_VALUE_STR(startup_split),
+     ECORE_GETOPT_VALUE_STR(restore),
      ECORE_GETOPT_VALUE_STR(video_module),
 
      ECORE_GETOPT_VALUE_BOOL(login_shell),
@@ -795,7 +802,7 @@ remote:
    if ((!single) && (config->multi_instance))
      {
         Ipc_Instance inst;
-        char cwdbuf[4096];
+        char cwdbuf[4096], restorebuf[PATH_MAX];
         
         memset(&inst, 0, sizeof(Ipc_Instance));
         
@@ -823,6 +830,8 @@ remote:
         inst.hold = hold;
         inst.nowm = nowm;
         inst.startup_split = startup_split;
+        if ((restore) && (realpath(restore, restorebuf)))
+          inst.restore = restorebuf;
         if (ipc_instance_add(&inst))
           goto end;
      }
@@ -872,6 +881,9 @@ remote:
         goto end;
      }
 
+   if (restore)
+     termio_snapshot_restore(term_termio_get(term), restore);
+
    main_trans_update(config);
    main_media_update(config);
    win_sizing_handle(wn);
@@ -1462,6 +1462,20 @@ media_get(const Evas_Object *obj)
    return sd->realf;
 }
 
+/* size in pixels of the image shown, 0x0 for edje objects and movies */
+void
+media_image_size_get(const Evas_Object *obj, int *w, int *h)
+{
+   Media *sd = evas_object_smart_data_get(obj);
+
+   *w = *h = 0;
+   if ((!sd) || (!sd->o_img)) return;
+   if ((sd->type != MEDIA_TYPE_IMG) && (sd->type != MEDIA_TYPE_SCALE) &&
+       (sd->type != MEDIA_TYPE_THUMB))
+     return;
+   evas_object_image_size_get(sd->o_img, w, h);
+}
+
 Media_Type
 media_src_type_get(const char *src)
 {
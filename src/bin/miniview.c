@@ -7,6 +7,7 @@
 #include "miniview.h"
 #include "col.h"
 #include "termpty.h"
+#include "termptysave.h"
 #include "termio.h"
 #include "utils.h"
 #include "main.h"
@@ -63,9 +64,34 @@ struct _Miniview
 
    Ecore_Timer *deferred_renderer;
 
+   /* the textgrid palettes, as pixels, when colors_gen was current */
+   unsigned int colors[512];
+   unsigned int colors_gen;
+   Color_Pair *row_colors;
+   unsigned int row_colors_size;
+
+   /* the image as last drawn: pixel row y is termpty row img_hist + y as
+    * it was when backlog_pushed was pushed, see _pixels_shift() */
+   struct {
+      unsigned int *pixels;
+      unsigned char *backlog; /* rows drawn from the backlog */
+      unsigned int cols, h;
+      int hist, ty_w;
+      long pushed;
+      unsigned int colors_gen;
+      unsigned int inv : 1;
+      unsigned int valid : 1;
+   } drawn;
+
+   /* level of the backlog summary shown, -1 for one pixel row per row */
+   int zoom;
+   /* summary rows, and the first one shown */
+   int zoom_rows, zoom_first;
+
    unsigned int is_shown : 1;
    unsigned int to_render : 1;
    unsigned int initial_pos : 1;
+   unsigned int colors_set : 1;
 
    Eina_Bool fits_to_img;
 
@@ -78,61 +104,21 @@ struct _Miniview
 static Evas_Smart *_smart = NULL;
 
 static void
-_draw_cell(const Termpty *ty, unsigned int *pixel, const Termcell *cell, unsigned int *colors)
-{
-   int fg, bg, fgext, bgext;
-   int inv = ty->termstate.reverse;
-   Eina_Unicode codepoint;
-
-   codepoint = cell->codepoint;
-   if ((codepoint == 0) || (cell->att.newline) || (cell->att.invisible))
-     {
-        *pixel = 0;
-        return;
-     }
-   // colors
-   fg = cell->att.fg;
-   bg = cell->att.bg;
-   fgext = cell->att.fg256;
-   bgext = cell->att.bg256;
-
-   if ((fg == COL_DEF) && (cell->att.inverse ^ inv)) fg = COL_INVERSEBG;
-   if (bg == COL_DEF)
-     {
-        if (cell->att.inverse ^ inv) bg = COL_INVERSE;
-        else if (!bgext) bg = COL_INVIS;
-     }
-   if ((cell->att.fgintense) && (!fgext)) fg += 48;
-   if ((cell->att.bgintense) && (!bgext)) bg += 48;
-   if (cell->att.inverse ^ inv)
-     {
-        int t;
-        t = fgext; fgext = bgext; bgext = t;
-        t = fg; fg = bg; bg = t;
-     }
-   if ((cell->att.bold) && (!fgext)) fg += 12;
-   if ((cell->att.faint) && (!fgext)) fg += 24;
-   
-   if (bgext) *pixel = colors[bg + 256];
-   else if (bg && ((bg % 12) != COL_INVIS)) *pixel = colors[bg];
-   else if ((codepoint > 32) && (codepoint < 0x00110000))
-     {
-        if (fgext) *pixel = colors[fg + 256];
-        else *pixel = colors[fg];
-     }
-   else
-     *pixel = 0;
-}
-
-static void
-_draw_line(const Termpty *ty, unsigned int *pixels,
-           const Termcell *cells, int length, unsigned int *colors)
+_draw_line(Miniview *mv, const Termpty *ty, unsigned int *pixels,
+           const Termcell *cells, int length)
 {
+   const Color_Pair *col;
    int x;
 
-   for (x = 0 ; x < length; x++)
+   if (length > (int)mv->cols) length = mv->cols;
+   if (length <= 0) return;
+   col = mv->row_colors;
+   colors_row_get(cells, length, ty->termstate.reverse, mv->row_colors);
+   for (x = 0; x < length; x++)
      {
-        _draw_cell(ty, pixels + x, cells + x, colors);
+        int c = colors_cell_minimap_get(&cells[x], &col[x]);
+
+        pixels[x] = (c >= 0) ? mv->colors[c] : 0;
      }
 }
 
@@ -145,7 +131,9 @@ _is_top_bottom_reached(Miniview *mv)
    EINA_SAFETY_ON_NULL_RETURN_VAL(mv, EINA_FALSE);
 
    ty = termio_pty_get(mv->termio);
+   termpty_backlog_lock(ty);
    history_len = termpty_backlog_length(ty);
+   termpty_backlog_unlock(ty);
 
    if (( (- mv->img_hist) > (int)(mv->img_h - mv->rows - (mv->rows / 2))) &&
        ( (- mv->img_hist) < (int)(history_len + (mv->rows / 2))))
@@ -181,6 +169,109 @@ _queue_render(Miniview *mv)
      mv->deferred_renderer = ecore_timer_add(0.1, _deferred_renderer, mv);
 }
 
+/* Zoomed out, the miniview shows the summary of the backlog kept by
+ * termptysave.c, every pixel row standing for TERMSAVE_SUMMARY_RATIO^(zoom
+ * + 1) backlog rows, the newest at the bottom.  Drawing it only depends
+ * on the size of the miniview, however long the backlog is.
+ */
+
+static int
+_zoom_scale(const Miniview *mv)
+{
+   int scale = TERMSAVE_SUMMARY_RATIO, l;
+
+   for (l = 0; l < mv->zoom; l++)
+     scale *= TERMSAVE_SUMMARY_RATIO;
+   return scale;
+}
+
+static void
+_zoom_set(Miniview *mv, int zoom)
+{
+   Termpty *ty = termio_pty_get(mv->termio);
+
+   if (zoom < -1) zoom = -1;
+   if (zoom >= TERMSAVE_SUMMARY_LEVELS) zoom = TERMSAVE_SUMMARY_LEVELS - 1;
+   if (zoom > mv->zoom)
+     {
+        int rows;
+
+        termpty_save_summary_set(ty);
+        /* no need to go further once the whole backlog is shown */
+        termpty_backlog_lock(ty);
+        rows = (mv->zoom >= 0) ? termpty_save_summary_rows(ty, mv->zoom) : 0;
+        termpty_backlog_unlock(ty);
+        if ((mv->zoom >= 0) && (rows <= (int)mv->img_h)) return;
+     }
+   if (zoom == mv->zoom) return;
+   mv->zoom = zoom;
+   mv->drawn.valid = 0;
+   if (zoom < 0)
+     {
+        mv->img_hist = 0;
+        mv->initial_pos = 1;
+        edje_object_part_drag_size_set(mv->base, "miniview_screen",
+                                       1.0, mv->screen.size);
+     }
+   _queue_render(mv);
+}
+
+/* scrolls the terminal for the bottom of its view to be at pixel row y */
+static void
+_zoom_scroll_to(Miniview *mv, int y)
+{
+   int scroll;
+
+   scroll = (mv->zoom_rows - mv->zoom_first - y) * _zoom_scale(mv);
+   if (scroll < 0) scroll = 0;
+   termio_scroll_set(mv->termio, scroll);
+}
+
+static void
+_zoom_render(Miniview *mv, Termpty *ty)
+{
+   unsigned short row[TERMSAVE_SUMMARY_W];
+   unsigned int *pixels, x, cols = MIN(mv->cols, TERMSAVE_SUMMARY_W);
+   int y, n, first, scale, bottom, h;
+
+   /* built again if the palette changed */
+   termpty_save_summary_set(ty);
+   evas_object_image_size_set(mv->img, mv->cols, mv->img_h);
+   pixels = evas_object_image_data_get(mv->img, EINA_TRUE);
+   if (!pixels) return;
+   memset(pixels, 0, sizeof(*pixels) * mv->cols * mv->img_h);
+   termpty_backlog_lock(ty);
+   n = termpty_save_summary_rows(ty, mv->zoom);
+   first = (n > (int)mv->img_h) ? n - (int)mv->img_h : 0;
+   for (y = 0; first + y < n; y++)
+     {
+        unsigned int *p = &pixels[y * mv->cols];
+
+        if (!termpty_save_summary_row_get(ty, mv->zoom, first + y, row))
+          break;
+        for (x = 0; x < cols; x++)
+          p[x] = row[x] ? mv->colors[row[x] - 1] : 0;
+     }
+   termpty_backlog_unlock(ty);
+   evas_object_image_data_set(mv->img, pixels);
+   evas_object_image_pixels_dirty_set(mv->img, EINA_FALSE);
+   evas_object_image_data_update_add(mv->img, 0, 0, mv->cols, mv->img_h);
+   mv->zoom_rows = n;
+   mv->zoom_first = first;
+
+   /* the screen marker shows the view among the rows of the summary */
+   scale = _zoom_scale(mv);
+   h = (mv->rows + scale - 1) / scale;
+   if (h >= (int)mv->img_h) h = mv->img_h - 1;
+   bottom = n - first - (termio_scroll_get(mv->termio) / scale);
+   mv->screen.pos_val = (double)(bottom - h) / (mv->img_h - h);
+   edje_object_part_drag_size_set(mv->base, "miniview_screen", 1.0,
+                                  (double)h / mv->img_h);
+   edje_object_part_drag_value_set(mv->base, "miniview_screen", 0.0,
+                                   mv->screen.pos_val);
+   _screen_visual_bounds(mv);
+}
+
 static void
 _smart_cb_mouse_wheel(void *data, Evas *e EINA_UNUSED,
                       Evas_Object *obj EINA_UNUSED, void *event)
@@ -192,6 +283,13 @@ _smart_cb_mouse_wheel(void *data, Evas *e EINA_UNUSED,
 
    /* do not handle horizontal scrolling */
    if (ev->direction) return;
+   if (evas_key_modifier_is_set(ev->modifiers, "Control"))
+     {
+        _zoom_set(mv, mv->zoom + ((ev->z > 0) ? 1 : -1));
+        return;
+     }
+   /* the whole backlog is shown already */
+   if (mv->zoom >= 0) return;
    mv->img_hist += ev->z * 25;
 
    if (!mv->fits_to_img && !_is_top_bottom_reached(mv))
@@ -211,6 +309,8 @@ miniview_position_offset(Evas_Object *obj, int by, Eina_Bool sanitize)
 
    termio_scroll_get(mv->termio);
    EINA_SAFETY_ON_NULL_RETURN(mv);
+   /* the marker is put back when drawing */
+   if (mv->zoom >= 0) return;
    if ((mv->screen.pos_val <= 1.0) && (mv->screen.pos_val >= 0.0))
      edje_object_signal_emit(mv->base, "miniview_screen,inbounds", "miniview");
 
@@ -259,7 +359,7 @@ miniview_handle_key(Evas_Object *obj, const Evas_Event_Key_Down *ev)
    EINA_SAFETY_ON_NULL_RETURN_VAL(obj, EINA_FALSE);
 
    mv = evas_object_smart_data_get(obj);
-   if ((!mv) || (!mv->is_shown)) return EINA_FALSE;
+   if ((!mv) || (!mv->is_shown) || (mv->zoom >= 0)) return EINA_FALSE;
 
    evas_object_geometry_get(mv->img, &ox, &oy, &ow, &oh);
    evas_pointer_canvas_xy_get(evas_object_evas_get(mv->base), &mx, &my);
@@ -317,6 +417,12 @@ _smart_cb_mouse_down(void *data, Evas *e EINA_UNUSED,
    EINA_SAFETY_ON_NULL_RETURN(mv);
 
    evas_object_geometry_get(mv->img, NULL, &oy, NULL, NULL);
+   if (mv->zoom >= 0)
+     {
+        _zoom_scroll_to(mv, ev->canvas.y - oy + (mv->rows / 2) /
+                        _zoom_scale(mv));
+        return;
+     }
    pos = oy - ev->canvas.y;
    pos -= mv->img_hist;
    if (pos < 0) pos = 0;
@@ -352,6 +458,13 @@ _on_screen_moved(void *data, Evas_Object *o, const char *emission EINA_UNUSED,
    double val = 0.0, pos = 0.0, bottom_bound = 0.0;
 
    edje_object_part_drag_value_get(o, "miniview_screen", NULL, &val);
+   if (mv->zoom >= 0)
+     {
+        int h = (mv->rows + _zoom_scale(mv) - 1) / _zoom_scale(mv);
+
+        _zoom_scroll_to(mv, (int)round(val * (mv->img_h - h)) + h);
+        return;
+     }
    bottom_bound = ((double) (-mv->img_hist )) / (mv->img_h - mv->rows);
    if (!mv->fits_to_img)
      {
@@ -383,6 +496,7 @@ _smart_add(Evas_Object *obj)
    EINA_SAFETY_ON_NULL_RETURN(mv);
    evas_object_smart_data_set(obj, mv);
    mv->self = obj;
+   mv->zoom = -1;
 }
 
 static void
@@ -394,6 +508,9 @@ _smart_del(Evas_Object *obj)
    ecore_timer_del(mv->deferred_renderer);
    evas_object_del(mv->base);
    evas_object_del(mv->img);
+   free(mv->row_colors);
+   free(mv->drawn.pixels);
+   free(mv->drawn.backlog);
    free(mv);
 }
 
@@ -482,7 +599,11 @@ miniview_colors_get(Miniview *mv, unsigned int *colors)
 {
    Evas_Object *tg = termio_textgrid_get(mv->termio);
    int r, g, b, a, c;
-   
+
+   if ((mv->colors_set) && (mv->colors_gen == colors_generation_get()))
+     return;
+   mv->colors_gen = colors_generation_get();
+   mv->colors_set = 1;
    for (c = 0; c < 256; c++)
      {
         evas_object_textgrid_palette_get
@@ -497,17 +618,69 @@ miniview_colors_get(Miniview *mv, unsigned int *colors)
      }
 }
 
+/* Rows of the backlog do not change while they are in it, but for the
+ * last one while its line can still grow, see termpty_backlog_row_open(),
+ * so the pixels drawn from them are moved along when output comes or the
+ * view moves and only the other rows are drawn again.  Returns the number of rows
+ * the pixels moved by, or -1 if nothing is left to keep */
+static int
+_pixels_shift(Miniview *mv, const Termpty *ty)
+{
+   unsigned int h = mv->img_h, cols = mv->cols, from, to, n;
+   long d;
+
+   if ((mv->drawn.cols != cols) || (mv->drawn.h != h) || (!mv->drawn.pixels))
+     {
+        unsigned int *pixels;
+        unsigned char *backlog;
+
+        pixels = realloc(mv->drawn.pixels, sizeof(*pixels) * cols * h);
+        if (!pixels) return -1;
+        mv->drawn.pixels = pixels;
+        backlog = realloc(mv->drawn.backlog, h);
+        if (!backlog) return -1;
+        mv->drawn.backlog = backlog;
+        mv->drawn.cols = cols;
+        mv->drawn.h = h;
+        mv->drawn.valid = 0;
+     }
+   if ((!mv->drawn.valid) || (mv->drawn.ty_w != ty->w) ||
+       (mv->drawn.inv != ty->termstate.reverse) ||
+       (mv->drawn.colors_gen != mv->colors_gen))
+     d = h;
+   else
+     d = (ty->backlog_pushed - mv->drawn.pushed) +
+         (mv->img_hist - mv->drawn.hist);
+   if ((d >= (long)h) || (d <= -(long)h))
+     {
+        memset(mv->drawn.backlog, 0, h);
+        return -1;
+     }
+   if (d == 0) return 0;
+   n = h - labs(d);
+   to = (d < 0) ? -d : 0;
+   from = to + d;
+   memmove(mv->drawn.pixels + (to * cols), mv->drawn.pixels + (from * cols),
+           sizeof(*mv->drawn.pixels) * cols * n);
+   memmove(mv->drawn.backlog + to, mv->drawn.backlog + from, n);
+   if (d > 0)
+     memset(mv->drawn.backlog + n, 0, d);
+   else
+     memset(mv->drawn.backlog, 0, -d);
+   return (int)d;
+}
+
 static Eina_Bool
 _deferred_renderer(void *data)
 {
    Miniview *mv = data;
    Evas_Coord ox, oy, ow, oh;
-   int history_len, pos;
+   int history_len, pos, shift, y1 = -1, y2 = -1;
+   long oldest;
    ssize_t wret;
    unsigned int *pixels, y;
    Termcell *cells;
    Termpty *ty;
-   unsigned int colors[512];
    double bottom_bound;
 
    if (!mv) return EINA_FALSE;
@@ -518,37 +691,92 @@ _deferred_renderer(void *data)
         return EINA_FALSE;
      }
 
-   miniview_colors_get(mv, colors);
+   miniview_colors_get(mv, mv->colors);
+   if (mv->row_colors_size < mv->cols)
+     {
+        Color_Pair *tmp = realloc(mv->row_colors,
+                                  mv->cols * sizeof(Color_Pair));
+
+        if (!tmp) return EINA_TRUE;
+        mv->row_colors = tmp;
+        mv->row_colors_size = mv->cols;
+     }
 
    ty = termio_pty_get(mv->termio);
    evas_object_geometry_get(mv->termio, &ox, &oy, &ow, &oh);
    if ((ow == 0) || (oh == 0) || (mv->cols == 1)) return EINA_TRUE;
+   if (mv->zoom >= 0)
+     {
+        _zoom_render(mv, ty);
+        mv->to_render = 0;
+        mv->deferred_renderer = NULL;
+        return EINA_FALSE;
+     }
 
+   termpty_backlog_lock(ty);
    history_len = termpty_backlog_length(ty);
 
    evas_object_image_size_set(mv->img, mv->cols, mv->img_h);
    ow = mv->cols;
    oh = mv->img_h;
 
-   pixels = evas_object_image_data_get(mv->img, EINA_TRUE);
-   memset(pixels, 0, sizeof(*pixels) * ow * oh);
-   mv->img_h = oh;
-
    /* "current"? */
    if (mv->img_hist >= - ((int)mv->img_h - (int)mv->rows))
      mv->img_hist = -((int)mv->img_h - (int)mv->rows);
    if (mv->img_hist < -history_len)
      mv->img_hist = -history_len;
 
+   shift = _pixels_shift(mv, ty);
+   if (!mv->drawn.pixels)
+     {
+        termpty_backlog_unlock(ty);
+        return EINA_TRUE;
+     }
+   oldest = ty->backlog_pushed - history_len;
    for (y = 0; y < mv->img_h; y++)
      {
-        cells = termpty_cellrow_get(ty, mv->img_hist + y, &wret);
-        if (!cells) break;
-        _draw_line(ty, &pixels[y * mv->cols], cells, wret, colors);
+        int row_y = mv->img_hist + y;
+
+        if ((mv->drawn.backlog[y]) &&
+            (ty->backlog_pushed + row_y >= oldest))
+          continue;
+        if (y1 < 0) y1 = y;
+        y2 = y;
+        pixels = &mv->drawn.pixels[y * mv->cols];
+        memset(pixels, 0, sizeof(*pixels) * mv->cols);
+        mv->drawn.backlog[y] = 0;
+        cells = termpty_cellrow_get(ty, row_y, &wret);
+        if (!cells) continue;
+        _draw_line(mv, ty, pixels, cells, wret);
+        mv->drawn.backlog[y] =
+           (row_y < 0) && (!termpty_backlog_row_open(ty, row_y, cells, wret));
+     }
+   mv->drawn.pushed = ty->backlog_pushed;
+   mv->drawn.hist = mv->img_hist;
+   mv->drawn.ty_w = ty->w;
+   mv->drawn.inv = ty->termstate.reverse;
+   mv->drawn.colors_gen = mv->colors_gen;
+   mv->drawn.valid = 1;
+   termpty_backlog_unlock(ty);
+
+   if (shift != 0)
+     {
+        y1 = 0;
+        y2 = oh - 1;
+     }
+   if (y1 >= 0)
+     {
+        /* the image may not keep its data, so all of it is given again */
+        pixels = evas_object_image_data_get(mv->img, EINA_TRUE);
+        if (pixels)
+          {
+             memcpy(pixels, mv->drawn.pixels, sizeof(*pixels) * ow * oh);
+             evas_object_image_data_set(mv->img, pixels);
+             evas_object_image_pixels_dirty_set(mv->img, EINA_FALSE);
+             evas_object_image_data_update_add(mv->img, 0, y1,
+                                               ow, y2 - y1 + 1);
+          }
      }
-   evas_object_image_data_set(mv->img, pixels);
-   evas_object_image_pixels_dirty_set(mv->img, EINA_FALSE);
-   evas_object_image_data_update_add(mv->img, 0, 0, ow, oh);
 
    if (history_len > (int)(mv->img_h - mv->rows)) mv->fits_to_img = EINA_FALSE;
    else mv->fits_to_img = EINA_TRUE;
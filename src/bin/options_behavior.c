@@ -43,6 +43,8 @@ CB(gravatar,  0);
 CB(notabs,  1);
 CB(mv_always_show, 0);
 CB(ty_escapes, 0);
+CB(snapshot_on_exit, 0);
+CB(scrollback_index, 0);
 
 #undef CB
 
@@ -78,6 +80,18 @@ _cb_op_behavior_sback_chg(void *data, Evas_Object *obj, void *event EINA_UNUSED)
    config_save(config, NULL);
 }
 
+static void
+_cb_op_behavior_sback_budget_chg(void *data, Evas_Object *obj,
+                                 void *event EINA_UNUSED)
+{
+   Evas_Object *term = data;
+   Config *config = termio_config_get(term);
+
+   config->scrollback_budget = (int)round(elm_slider_value_get(obj));
+   termio_config_update(term);
+   config_save(config, NULL);
+}
+
 static void
 _cb_op_behavior_tab_zoom_slider_chg(void *data, Evas_Object *obj,
                                     void *event EINA_UNUSED)
@@ -193,6 +207,8 @@ options_behavior(Evas_Object *opbox, Evas_Object *term)
    CX(_("Show tabs"), notabs, 1);
    CX(_("Always show miniview"), mv_always_show, 0);
    CX(_("Enable special Terminology escape codes"), ty_escapes, 0);
+   CX(_("Save screen and scrollback when closing"), snapshot_on_exit, 0);
+   CX(_("Index scrollback for faster searches"), scrollback_index, 0);
 
 #undef CX
 
@@ -288,6 +304,35 @@ options_behavior(Evas_Object *opbox, Evas_Object *term)
    evas_object_smart_callback_add(o, "delay,changed",
                                   _cb_op_behavior_sback_chg, term);
 
+   o = elm_label_add(bx);
+   evas_object_size_hint_weight_set(o, 0.0, 0.0);
+   evas_object_size_hint_align_set(o, 0.0, 0.5);
+   elm_object_text_set(o, _("Scrollback memory for all terminals:"));
+   tooltip = _("When all terminals together use more memory<br>"
+       "than this, the oldest lines of the terminals<br>"
+       "that were not focused recently are dropped.<br>"
+       "0 means no limit");
+   elm_object_tooltip_text_set(o, tooltip);
+   elm_box_pack_end(bx, o);
+   evas_object_show(o);
+
+   o = elm_slider_add(bx);
+   elm_object_tooltip_text_set(o, tooltip);
+   evas_object_size_hint_weight_set(o, EVAS_HINT_EXPAND, 0.0);
+   evas_object_size_hint_align_set(o, EVAS_HINT_FILL, 0.0);
+   elm_slider_span_size_set(o, 40);
+#if (EINA_VERSION_MAJOR > 1) || (EINA_VERSION_MINOR >= 8)
+   elm_slider_step_set(o, 16);
+#endif
+   elm_slider_unit_format_set(o, _("%1.0f MiB"));
+   elm_slider_indicator_format_set(o, _("%1.0f MiB"));
+   elm_slider_min_max_set(o, 0.0, 4096.0);
+   elm_slider_value_set(o, config->scrollback_budget);
+   elm_box_pack_end(bx, o);
+   evas_object_show(o);
+   evas_object_smart_callback_add(o, "delay,changed",
+                                  _cb_op_behavior_sback_budget_chg, term);
+
    o = elm_label_add(bx);
    evas_object_size_hint_weight_set(o, 0.0, 0.0);
    evas_object_size_hint_align_set(o, 0.0, 0.5);
@@ -51,6 +51,18 @@ _cb_op_video_visualize_chg(void *data, Evas_Object *obj, void *event EINA_UNUSED
    config_save(config, NULL);
 }
 
+static void
+_cb_op_video_media_cache_chg(void *data, Evas_Object *obj,
+                             void *event EINA_UNUSED)
+{
+   Evas_Object *term = data;
+   Config *config = termio_config_get(term);
+
+   config->media_cache = (int)round(elm_slider_value_get(obj));
+   termio_config_update(term);
+   config_save(config, NULL);
+}
+
 static void
 _cb_op_video_vidmod_chg(void *data, Evas_Object *obj, void *event EINA_UNUSED)
 {
@@ -68,6 +80,7 @@ options_video(Evas_Object *opbox, Evas_Object *term)
 {
    Evas_Object *o, *fr, *bx0;
    Config *config = termio_config_get(term);
+   const char *tooltip;
 
    fr = o = elm_frame_add(opbox);
    evas_object_size_hint_weight_set(o, EVAS_HINT_EXPAND, EVAS_HINT_EXPAND);
@@ -136,6 +149,31 @@ options_video(Evas_Object *opbox, Evas_Object *term)
    evas_object_smart_callback_add(o, "changed",
                                   _cb_op_video_visualize_chg, term);
 
+   o = elm_label_add(opbox);
+   evas_object_size_hint_weight_set(o, 0.0, 0.0);
+   evas_object_size_hint_align_set(o, 0.0, 0.5);
+   elm_object_text_set(o, _("Memory for media scrolled out of view:"));
+   tooltip = _("Inline images scrolled out of view are kept<br>"
+       "ready to be shown again, up to this much memory<br>"
+       "per terminal. 0 means they are always reloaded");
+   elm_object_tooltip_text_set(o, tooltip);
+   elm_box_pack_end(bx0, o);
+   evas_object_show(o);
+
+   o = elm_slider_add(opbox);
+   elm_object_tooltip_text_set(o, tooltip);
+   evas_object_size_hint_weight_set(o, EVAS_HINT_EXPAND, 0.0);
+   evas_object_size_hint_align_set(o, EVAS_HINT_FILL, 0.5);
+   elm_slider_span_size_set(o, 40);
+   elm_slider_unit_format_set(o, _("%1.0f MiB"));
+   elm_slider_indicator_format_set(o, _("%1.0f MiB"));
+   elm_slider_min_max_set(o, 0.0, 512.0);
+   elm_slider_value_set(o, config->media_cache);
+   elm_box_pack_end(bx0, o);
+   evas_object_show(o);
+   evas_object_smart_callback_add(o, "delay,changed",
+                                  _cb_op_video_media_cache_chg, term);
+
    o = elm_separator_add(opbox);
    evas_object_size_hint_weight_set(o, EVAS_HINT_EXPAND, 0.0);
    evas_object_size_hint_align_set(o, EVAS_HINT_FILL, 0.5);
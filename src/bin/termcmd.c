@@ -4,22 +4,79 @@
 #include "main.h"
 #include "win.h"
 #include "termio.h"
+#include "termiosearch.h"
 #include "config.h"
 #include "controls.h"
 #include "media.h"
 #include "utils.h"
 #include "termcmd.h"
 
+/* cmd is the text to look for, possibly prefixed with \C to match case,
+ * \< to match whole words only, a trailing \> being ignored, and \r for
+ * cmd to be an extended regular expression */
+static char *
+_termcmd_needle_get(const char *cmd, int *flags)
+{
+   char *needle;
+   size_t len;
+
+   *flags = 0;
+   while (cmd[0] == '\\')
+     {
+        if (cmd[1] == 'C')
+          *flags |= TERMIO_SEARCH_CASE_SENSITIVE;
+        else if (cmd[1] == '<')
+          *flags |= TERMIO_SEARCH_WHOLE_WORD;
+        else if (cmd[1] == 'r')
+          *flags |= TERMIO_SEARCH_REGEX;
+        else
+          break;
+        cmd += 2;
+     }
+   needle = strdup(cmd);
+   if (!needle) return NULL;
+   len = strlen(needle);
+   if ((*flags & TERMIO_SEARCH_WHOLE_WORD) && (len >= 2) &&
+       (!strcmp(needle + len - 2, "\\>")))
+     needle[len - 2] = '\0';
+   return needle;
+}
+
 static Eina_Bool
-_termcmd_search(Evas_Object *obj EINA_UNUSED, Evas_Object *win EINA_UNUSED, Evas_Object *bg EINA_UNUSED, const char *cmd)
+_termcmd_search(Evas_Object *obj, Evas_Object *win EINA_UNUSED, Evas_Object *bg EINA_UNUSED, const char *cmd, int dir)
 {
+   char *needle;
+   int flags;
+   Eina_Bool ret;
+
    if (cmd[0] == 0) // clear search
      {
-        printf("search clear\n");
+        termio_search_clear(obj);
         return EINA_TRUE;
      }
-   printf("search '%s'\n", cmd);
-   return EINA_TRUE;
+   needle = _termcmd_needle_get(cmd, &flags);
+   if (!needle) return EINA_FALSE;
+   ret = termio_search(obj, needle, flags, dir);
+   free(needle);
+   return ret;
+}
+
+/* only shows the lines matching cmd, as for a search, or all of them
+ * again when cmd is empty */
+static Eina_Bool
+_termcmd_filter(Evas_Object *obj, Evas_Object *win EINA_UNUSED, Evas_Object *bg EINA_UNUSED, const char *cmd)
+{
+   char *needle;
+   int flags;
+   Eina_Bool ret;
+
+   if (cmd[0] == 0)
+     return termio_filter(obj, NULL, 0);
+   needle = _termcmd_needle_get(cmd, &flags);
+   if (!needle) return EINA_FALSE;
+   ret = termio_filter(obj, needle, flags);
+   free(needle);
+   return ret;
 }
 
 static Eina_Bool
@@ -131,7 +188,9 @@ termcmd_watch(Evas_Object *obj, Evas_Object *win, Evas_Object *bg, const char *c
 {
    if (!cmd) return EINA_FALSE;
    if ((cmd[0] == '/') || (cmd[0] == 's'))
-     return _termcmd_search(obj, win, bg, cmd + 1);
+     return _termcmd_search(obj, win, bg, cmd + 1, -1);
+   if (cmd[0] == '?')
+     return _termcmd_search(obj, win, bg, cmd + 1, 1);
    return EINA_FALSE;
 }
 
@@ -141,7 +200,11 @@ termcmd_do(Evas_Object *obj, Evas_Object *win, Evas_Object *bg, const char *cmd)
 {
    if (!cmd || !cmd[0]) return EINA_FALSE;
    if ((cmd[0] == '/') || (cmd[0] == 's'))
-     return _termcmd_search(obj, win, bg, cmd + 1);
+     return _termcmd_search(obj, win, bg, cmd + 1, -1);
+   if (cmd[0] == '?')
+     return _termcmd_search(obj, win, bg, cmd + 1, 1);
+   if (cmd[0] == '|')
+     return _termcmd_filter(obj, win, bg, cmd + 1);
    if ((cmd[0] == 'f') || (cmd[0] == 'F'))
      return _termcmd_font_size(obj, win, bg, cmd + 1);
    if ((cmd[0] == 'g') || (cmd[0] == 'G'))
@@ -2,12 +2,20 @@
 
 #include <Elementary.h>
 #include <Ecore_Input.h>
+#include <Efreet.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "termio.h"
 #include "termiolink.h"
+#include "termiosearch.h"
+#include "termioexport.h"
 #include "termpty.h"
 #include "termcmd.h"
 #include "termptydbl.h"
+#include "termptysave.h"
+#include "termptylatency.h"
 #include "utf8.h"
 #include "col.h"
 #include "keyin.h"
@@ -24,6 +32,28 @@
 #endif
 
 typedef struct _Termio Termio;
+typedef struct _Linkmap_Link Linkmap_Link;
+typedef struct _Linkmap_Row Linkmap_Row;
+
+/* rows as backlog_pushed + y - scroll, like drawn rows */
+struct _Linkmap_Link
+{
+   const char *string; /* as written, stringshared */
+   long y1, y2;
+   int x1, x2;
+};
+
+struct _Linkmap_Row
+{
+   /* the links going through the row */
+   Linkmap_Link *links;
+   int n;
+   /* rows of its line */
+   long top, bottom;
+   unsigned char valid : 1;
+   unsigned char cut : 1; /* the line goes on past the view */
+   unsigned char stale : 1;
+};
 
 struct _Termio
 {
@@ -47,6 +77,13 @@ struct _Termio
    struct {
       int cx, cy;
       int button;
+      /* motion reports waiting for the next frame and the last one
+       * written, see _rep_mouse_write() */
+      struct {
+         Ecore_Animator *anim;
+         char buf[64], last[64];
+         int len, last_len;
+      } motion;
    } mouse;
    struct {
       char *string;
@@ -61,6 +98,52 @@ struct _Termio
          unsigned char dndobjdel : 1;
       } down;
    } link;
+   struct {
+      Termio_Search *s;
+      const char *needle;
+      int flags;
+      int dir;
+      Termio_Search_Match cur;
+      unsigned char found : 1;
+   } search;
+   struct {
+      Termio_Search *s;
+      const char *needle;
+      int flags;
+      /* matching rows of the backlog as backlog_pushed + y, the lines
+       * before done being all looked at */
+      long *rows;
+      int nrows, rows_size;
+      long done;
+      /* matching rows from done on, found again for every frame */
+      int *tail;
+      int ntail, tail_size;
+      Termcell *line;
+      int line_size;
+      unsigned char on : 1;
+   } filter;
+   /* colors of the row being drawn by _smart_apply() */
+   Color_Pair *row_colors;
+   int row_colors_size;
+   /* what the textgrid rows were drawn from, so that scrolling only has
+    * to convert the rows coming into view, see _drawn_shift() */
+   struct {
+      unsigned char *flags;
+      int h;
+      long pushed;
+      int scroll;
+      unsigned int colors_gen;
+      unsigned char inv : 1;
+      unsigned char valid : 1;
+      unsigned char screen_dirty : 1;
+   } drawn;
+   /* links of the textgrid rows, see _linkmap_shift() */
+   struct {
+      Linkmap_Row *rows;
+      int h;
+   } linkmap;
+   /* the patterns of config->links, compiled when first needed */
+   Termio_Link_Matcher *link_matcher;
    Evas_Object *ctxpopup;
    int zoom_fontsize_start;
    int scroll;
@@ -75,11 +158,23 @@ struct _Termio
    Ecore_Timer *mouse_selection_scroll_timer;
    Ecore_Job *mouse_move_job;
    Ecore_Timer *mouseover_delay;
+   /* frames held back while the application asks for a synchronized
+    * update, see _smart_cb_change() */
+   struct {
+      Ecore_Timer *timer;
+      unsigned long held, held_total;
+      unsigned char expired : 1;
+   } sync;
    Evas_Object *win, *theme, *glayer;
    Config *config;
    const char *sel_str;
    const char *preedit_str;
    Eina_List *cur_chids;
+   /* blocks out of view whose object is only hidden, oldest first */
+   struct {
+      Eina_List *blocks;
+      size_t mem;
+   } block_cache;
    Ecore_Job *sel_reset_job;
    double set_sel_at;
    Elm_Sel_Type sel_type;
@@ -93,6 +188,8 @@ struct _Termio
    unsigned char bottom_right : 1;
    unsigned char top_left : 1;
    unsigned char reset_sel : 1;
+   unsigned char hidden : 1; /* nobody can see it, so nothing is drawn */
+   unsigned char hidden_changed : 1; /* to be drawn once shown */
 };
 
 #define INT_SWAP(_a, _b) do {    \
@@ -109,9 +206,15 @@ static void _sel_set(Termio *sd, Eina_Bool enable);
 static void _remove_links(Termio *sd, Evas_Object *obj);
 static void _smart_update_queue(Evas_Object *obj, Termio *sd);
 static void _smart_apply(Evas_Object *obj);
+static void _drawn_reset(Termio *sd);
+static char *_linkmap_find(Termio *sd, int cx, int cy, int *x1r, int *y1r, int *x2r, int *y2r);
+static void _linkmap_free(Termio *sd);
 static void _smart_size(Evas_Object *obj, int w, int h, Eina_Bool force);
 static void _smart_calculate(Evas_Object *obj);
 static void _take_selection_text(Termio *sd, Elm_Sel_Type type, const char *text);
+static void _selection_export_rows(Termio *sd, Termio_Export *e, int c1x, int c1y, int c2x, int c2y, int from, int to);
+static void _block_cache_del(Termio *sd, Termblock *blk);
+static void _block_cache_trim(Termio *sd, size_t max);
 static void _smart_xy_to_cursor(Termio *sd, Evas_Coord x, Evas_Coord y, int *cx, int *cy);
 static Eina_Bool _mouse_in_selection(Termio *sd, int cx, int cy);
 
@@ -127,13 +230,19 @@ termio_scroll(Evas_Object *obj, int direction, int start_y, int end_y)
    EINA_SAFETY_ON_NULL_RETURN(sd);
 
    if ((!sd->jump_on_change) && // if NOT scroll to bottom on updates
-       (sd->scroll > 0))
+       (sd->scroll > 0) && (!sd->filter.on))
      {
         Evas_Object *mv = term_miniview_get(sd->term);
         if (mv) miniview_position_offset(mv, direction, EINA_FALSE);
         // adjust scroll position for added scrollback
         sd->scroll -= direction;
      }
+   if ((sd->search.s) && (start_y == 0))
+     {
+        termio_search_shift(sd->search.s, start_y, direction);
+        sd->search.cur.y1 += direction;
+        sd->search.cur.y2 += direction;
+     }
    ty = sd->pty;
    if (ty->selection.is_active)
      {
@@ -177,6 +286,33 @@ termio_scroll(Evas_Object *obj, int direction, int start_y, int end_y)
      }
 }
 
+/* a terminal in a hidden tab or an iconified window only keeps the pty
+ * going: it is drawn again, once, when shown */
+void
+termio_visible_set(Evas_Object *obj, Eina_Bool visible)
+{
+   Termio *sd = evas_object_smart_data_get(obj);
+
+   EINA_SAFETY_ON_NULL_RETURN(sd);
+   if (sd->hidden == !visible) return;
+   sd->hidden = !visible;
+   if (sd->hidden)
+     {
+        if (sd->anim)
+          {
+             ecore_animator_del(sd->anim);
+             sd->anim = NULL;
+             sd->hidden_changed = EINA_TRUE;
+          }
+        return;
+     }
+   if (sd->hidden_changed)
+     {
+        sd->hidden_changed = EINA_FALSE;
+        _smart_update_queue(obj, sd);
+     }
+}
+
 void
 termio_content_change(Evas_Object *obj, Evas_Coord x, Evas_Coord y,
                       int n)
@@ -552,6 +688,177 @@ termio_win_get(Evas_Object *obj)
    return sd->win;
 }
 
+/* snapshots kept in $XDG_CACHE_HOME/terminology/snapshots/, the oldest
+ * ones being removed as new ones are saved there */
+#define SNAPSHOTS_MAX 16
+
+static int
+_cb_snapshot_newer(const void *d1, const void *d2)
+{
+   return strcmp(d2, d1);
+}
+
+/* removes the snapshots of dir but the SNAPSHOTS_MAX newest ones, their
+ * names starting with the date they were saved */
+static void
+_snapshots_prune(const char *dir)
+{
+   char path[PATH_MAX], *file;
+   Eina_List *files;
+   int n = 0;
+
+   files = ecore_file_ls(dir);
+   files = eina_list_sort(files, eina_list_count(files), _cb_snapshot_newer);
+   EINA_LIST_FREE(files, file)
+     {
+        if ((eina_str_has_extension(file, ".tysnap")) &&
+            (++n > SNAPSHOTS_MAX))
+          {
+             snprintf(path, sizeof(path), "%s/%s", dir, file);
+             if (!ecore_file_unlink(path))
+               WRN("could not remove old snapshot %s", path);
+          }
+        free(file);
+     }
+}
+
+/* saves the screen and backlog to path, or to a new file in
+ * $XDG_CACHE_HOME/terminology/snapshots/ if path is NULL */
+Eina_Bool
+termio_snapshot_save(Evas_Object *obj, const char *path)
+{
+   char buf[PATH_MAX], dir[PATH_MAX], date[64];
+   time_t t;
+   Termio *sd = evas_object_smart_data_get(obj);
+   EINA_SAFETY_ON_NULL_RETURN_VAL(sd, EINA_FALSE);
+
+   if (!path)
+     {
+        snprintf(dir, sizeof(dir), "%s/terminology/snapshots",
+                 efreet_cache_home_get());
+        ecore_file_mkpath(dir);
+        t = time(NULL);
+        strftime(date, sizeof(date), "%Y-%m-%d_%H-%M-%S", localtime(&t));
+        snprintf(buf, sizeof(buf), "%s/%s_%i.tysnap",
+                 dir, date, (int)termpty_pid_get(sd->pty));
+     }
+   if (!termpty_save_snapshot_write(sd->pty, path ? path : buf))
+     return EINA_FALSE;
+   INF("saved snapshot to %s", path ? path : buf);
+   if (!path) _snapshots_prune(dir);
+   return EINA_TRUE;
+}
+
+/* rows written by termio_scrollback_save() before letting go of the
+ * backlog for a while */
+#define SCROLLBACK_SAVE_ROWS 1024
+
+/* writes the text of the screen and backlog to path, or to a new file in
+ * $XDG_CACHE_HOME/terminology/scrollback/ if path is NULL, each chunk
+ * of the export going to the disk as it is filled */
+Eina_Bool
+termio_scrollback_save(Evas_Object *obj, const char *path,
+                       Termio_Export_Format format)
+{
+   static const char *exts[] = { "txt", "ansi", "html" };
+   char buf[PATH_MAX], date[64];
+   unsigned int colors[512];
+   Termio_Export *e;
+   time_t t;
+   long pushed, first, last, oldest, row, end;
+   int fd, r, g, b, a, c;
+   Eina_Bool ok;
+   Termio *sd = evas_object_smart_data_get(obj);
+   EINA_SAFETY_ON_NULL_RETURN_VAL(sd, EINA_FALSE);
+
+   if (!path)
+     {
+        snprintf(buf, sizeof(buf), "%s/terminology/scrollback",
+                 efreet_cache_home_get());
+        ecore_file_mkpath(buf);
+        t = time(NULL);
+        strftime(date, sizeof(date), "%Y-%m-%d_%H-%M-%S", localtime(&t));
+        snprintf(buf, sizeof(buf), "%s/terminology/scrollback/%s_%i.%s",
+                 efreet_cache_home_get(), date, (int)termpty_pid_get(sd->pty),
+                 exts[format]);
+        path = buf;
+     }
+   fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+   if (fd < 0)
+     {
+        ERR("could not open %s: %s", path, strerror(errno));
+        return EINA_FALSE;
+     }
+   e = termio_export_new(format, EINA_TRUE, termio_export_fd_write, &fd);
+   if (!e)
+     {
+        close(fd);
+        return EINA_FALSE;
+     }
+   if (format == TERMIO_EXPORT_HTML)
+     {
+        for (c = 0; c < 256; c++)
+          {
+             evas_object_textgrid_palette_get
+               (sd->grid.obj, EVAS_TEXTGRID_PALETTE_STANDARD, c,
+                &r, &g, &b, &a);
+             colors[c] = (a << 24) | (r << 16) | (g << 8) | b;
+             evas_object_textgrid_palette_get
+               (sd->grid.obj, EVAS_TEXTGRID_PALETTE_EXTENDED, c,
+                &r, &g, &b, &a);
+             colors[c + 256] = (a << 24) | (r << 16) | (g << 8) | b;
+          }
+        termio_export_palette_set(e, colors, sd->pty->termstate.reverse);
+     }
+   /* rows as backlog_pushed + y, so that the export can go on where it
+    * stopped once the backlog has been unlocked and moved */
+   termpty_backlog_lock(sd->pty);
+   pushed = sd->pty->backlog_pushed;
+   first = pushed - termpty_backlog_length(sd->pty);
+   last = pushed + sd->grid.h - 1;
+   termpty_backlog_unlock(sd->pty);
+   for (row = first; row <= last; row = end + 1)
+     {
+        termpty_backlog_lock(sd->pty);
+        pushed = sd->pty->backlog_pushed;
+        /* rows pushed out of the backlog meanwhile are lost */
+        oldest = pushed - termpty_backlog_length(sd->pty);
+        if (row < oldest) row = oldest;
+        end = row + SCROLLBACK_SAVE_ROWS - 1;
+        if (end > last) end = last;
+        if (row <= end)
+          _selection_export_rows(sd, e, 0, first - pushed,
+                                 sd->grid.w - 1, last - pushed,
+                                 row - pushed, end - pushed);
+        termpty_backlog_unlock(sd->pty);
+     }
+   ok = termio_export_end(e);
+   if (close(fd) < 0) ok = EINA_FALSE;
+   if (!ok)
+     {
+        ERR("could not save the scrollback to %s", path);
+        return EINA_FALSE;
+     }
+   INF("saved the scrollback to %s", path);
+   return EINA_TRUE;
+}
+
+Eina_Bool
+termio_snapshot_restore(Evas_Object *obj, const char *path)
+{
+   Termio *sd = evas_object_smart_data_get(obj);
+   EINA_SAFETY_ON_NULL_RETURN_VAL(sd, EINA_FALSE);
+   EINA_SAFETY_ON_NULL_RETURN_VAL(path, EINA_FALSE);
+
+   if (!termpty_save_snapshot_read(sd->pty, path))
+     return EINA_FALSE;
+   sd->scroll = 0;
+   _drawn_reset(sd);
+   _remove_links(sd, obj);
+   _smart_update_queue(obj, sd);
+   return EINA_TRUE;
+}
+
 
 /* }}} */
 /* {{{ Config */
@@ -582,7 +889,14 @@ termio_config_update(Evas_Object *obj)
    sd->jump_on_keypress = sd->config->jump_on_keypress;
 
    termpty_backlog_size_set(sd->pty, sd->config->scrollback);
+   termpty_save_budget_set((size_t)sd->config->scrollback_budget * 1024 * 1024);
+   termpty_save_index_set(sd->pty, sd->config->scrollback_index);
+   _block_cache_trim(sd, (size_t)sd->config->media_cache * 1024 * 1024);
    sd->scroll = 0;
+   /* the links may have changed */
+   _termio_link_matcher_free(sd->link_matcher);
+   sd->link_matcher = NULL;
+   _drawn_reset(sd);
 
    if (evas_object_focus_get(obj))
      {
@@ -616,6 +930,17 @@ termio_config_get(const Evas_Object *obj)
    return sd->config;
 }
 
+const Termio_Link_Matcher *
+termio_link_matcher_get(Evas_Object *obj)
+{
+   Termio *sd = evas_object_smart_data_get(obj);
+   EINA_SAFETY_ON_NULL_RETURN_VAL(sd, NULL);
+
+   if ((!sd->link_matcher) && (sd->config) && (sd->config->links))
+     sd->link_matcher = _termio_link_matcher_new(sd->config->links);
+   return sd->link_matcher;
+}
+
 void
 termio_config_set(Evas_Object *obj, Config *config)
 {
@@ -623,6 +948,8 @@ termio_config_set(Evas_Object *obj, Config *config)
    Evas_Coord w = 2, h = 2;
 
    sd->config = config;
+   _termio_link_matcher_free(sd->link_matcher);
+   sd->link_matcher = NULL;
 
    sd->jump_on_change = config->jump_on_change;
    sd->jump_on_keypress = config->jump_on_keypress;
@@ -1883,8 +2210,16 @@ _block_activate(Evas_Object *obj, Termblock *blk)
    if (blk->active)
      return;
    blk->active = EINA_TRUE;
+   if (blk->cached)
+     {
+        _block_cache_del(sd, blk);
+        evas_object_show(blk->obj);
+        sd->pty->block.active = eina_list_append(sd->pty->block.active, blk);
+        return;
+     }
    if (blk->obj)
      return;
+   blk->geometry_set = EINA_FALSE;
    if (blk->edje)
      _block_edje_activate(obj, blk);
    else
@@ -1895,6 +2230,28 @@ _block_activate(Evas_Object *obj, Termblock *blk)
      sd->pty->block.active = eina_list_append(sd->pty->block.active, blk);
 }
 
+/* only touches the object when the block moved or the font changed */
+static void
+_block_geometry_set(Termio *sd, Termblock *blk, Evas_Coord ox, Evas_Coord oy)
+{
+   Evas_Coord x, y, w, h;
+
+   if (!blk->obj) return;
+   x = ox + (blk->x * sd->font.chw);
+   y = oy + (blk->y * sd->font.chh);
+   w = blk->w * sd->font.chw;
+   h = blk->h * sd->font.chh;
+   if ((!blk->geometry_set) || (blk->ox != x) || (blk->oy != y))
+     evas_object_move(blk->obj, x, y);
+   if ((!blk->geometry_set) || (blk->ow != w) || (blk->oh != h))
+     evas_object_resize(blk->obj, w, h);
+   blk->ox = x;
+   blk->oy = y;
+   blk->ow = w;
+   blk->oh = h;
+   blk->geometry_set = EINA_TRUE;
+}
+
 static void
 _block_obj_del(Termblock *blk)
 {
@@ -1907,6 +2264,88 @@ _block_obj_del(Termblock *blk)
    blk->obj = NULL;
 }
 
+/* Blocks going out of view keep their object, hidden, so that scrolling
+ * back to them does not load the media again.  Those objects are
+ * accounted for as the pixels of their image at 32bpp, plus
+ * BLOCK_CACHE_OBJ_SIZE for the object itself, and the least recently
+ * hidden ones are deleted once over config->media_cache.  Movies are not
+ * kept as they would go on playing. */
+
+#define BLOCK_CACHE_OBJ_SIZE 4096
+
+static size_t
+_block_cache_size(const Termblock *blk)
+{
+   int w = 0, h = 0;
+
+   /* edje objects draw into the canvas, they hold no image of their own */
+   if (!blk->edje) media_image_size_get(blk->obj, &w, &h);
+   return BLOCK_CACHE_OBJ_SIZE + (size_t)w * h * 4;
+}
+
+static void
+_block_cache_obj_del(void *data, Evas *e EINA_UNUSED,
+                     Evas_Object *obj EINA_UNUSED, void *info EINA_UNUSED)
+{
+   Termblock *blk = data;
+   Termio *sd = evas_object_smart_data_get(blk->pty->obj);
+
+   EINA_SAFETY_ON_NULL_RETURN(sd);
+   _block_cache_del(sd, blk);
+}
+
+static void
+_block_cache_del(Termio *sd, Termblock *blk)
+{
+   if (!blk->cached) return;
+   sd->block_cache.blocks =
+      eina_list_remove_list(sd->block_cache.blocks, blk->cached);
+   blk->cached = NULL;
+   sd->block_cache.mem -= blk->cached_mem;
+   /* gone already when deleted along with the block */
+   if (blk->obj)
+     evas_object_event_callback_del_full(blk->obj, EVAS_CALLBACK_DEL,
+                                         _block_cache_obj_del, blk);
+}
+
+static void
+_block_cache_trim(Termio *sd, size_t max)
+{
+   while ((sd->block_cache.blocks) && (sd->block_cache.mem > max))
+     {
+        Termblock *blk = eina_list_data_get(sd->block_cache.blocks);
+
+        _block_cache_del(sd, blk);
+        _block_obj_del(blk);
+     }
+}
+
+static void
+_block_cache_add(Termio *sd, Termblock *blk)
+{
+   size_t max = (size_t)sd->config->media_cache * 1024 * 1024;
+
+   if ((!blk->obj) || (!blk->geometry_set) ||
+       (blk->type == MEDIA_TYPE_MOV))
+     {
+        _block_obj_del(blk);
+        return;
+     }
+   blk->cached_mem = _block_cache_size(blk);
+   if (blk->cached_mem > max)
+     {
+        _block_obj_del(blk);
+        return;
+     }
+   evas_object_hide(blk->obj);
+   sd->block_cache.blocks = eina_list_append(sd->block_cache.blocks, blk);
+   blk->cached = eina_list_last(sd->block_cache.blocks);
+   sd->block_cache.mem += blk->cached_mem;
+   evas_object_event_callback_add(blk->obj, EVAS_CALLBACK_DEL,
+                                  _block_cache_obj_del, blk);
+   _block_cache_trim(sd, max);
+}
+
 /* }}} */
 /* {{{ Keys */
 
@@ -1950,6 +2389,7 @@ _smart_cb_key_down(void *data, Evas *e EINA_UNUSED,
       evas_key_modifier_is_set(ev->modifiers, "ISO_Level3_Shift");
    hyper = evas_key_modifier_is_set(ev->modifiers, "Hyper");
 
+   if (sd->pty->latency) termpty_latency_key_begin(sd->pty->latency);
    if (keyin_handle(&sd->khdl, sd->pty, ev, ctrl, alt, shift, win, meta, hyper))
      goto end;
 
@@ -1962,6 +2402,7 @@ _smart_cb_key_down(void *data, Evas *e EINA_UNUSED,
           }
      }
 end:
+   if (sd->pty->latency) termpty_latency_key_end(sd->pty->latency);
    if (sd->config->flicker_on_key)
      edje_object_signal_emit(sd->cursor.obj, "key,down", "terminology");
 }
@@ -2005,64 +2446,15 @@ _mouse_in_selection(Termio *sd, int cx, int cy)
      return EINA_FALSE;
 }
 
-struct termio_sb {
-   char *buf;
-   size_t len;
-   size_t alloc;
-};
-
-static int
-_sb_add(struct termio_sb *sb, const char *s, size_t len)
-{
-   size_t new_len = sb->len + len;
-
-   if ((new_len >= sb->alloc) || !sb->buf)
-     {
-        size_t new_alloc = ((new_len + 15) / 16) * 24;
-        char *new_buf;
-
-        new_buf = realloc(sb->buf, new_alloc);
-        if (new_buf == NULL)
-          return -1;
-        sb->buf = new_buf;
-        sb->alloc = new_alloc;
-     }
-   memcpy(sb->buf + sb->len, s, len);
-   sb->len += len;
-   sb->buf[sb->len] = '\0';
-   return 0;
-}
-
-/* unlike eina_strbuf_rtrim, only trims \t, \f, ' ' */
+/* writes the rows from to to of the text from c1x,c1y to c2x,c2y to e,
+ * the backlog being locked */
 static void
-_sb_spaces_rtrim(struct termio_sb *sb)
-{
-   if (!sb->buf)
-     return;
-
-   while (sb->len > 0)
-     {
-        char c = sb->buf[sb->len - 1];
-        if ((c != ' ') && (c != '\t') && (c != '\f'))
-            break;
-        sb->len--;
-     }
-   sb->buf[sb->len] = '\0';
-}
-
-
-char *
-termio_selection_get(Evas_Object *obj, int c1x, int c1y, int c2x, int c2y,
-                     size_t *lenp,
-                     Eina_Bool rtrim)
+_selection_export_rows(Termio *sd, Termio_Export *e,
+                       int c1x, int c1y, int c2x, int c2y, int from, int to)
 {
-   Termio *sd = evas_object_smart_data_get(obj);
-   struct termio_sb sb = {.buf = NULL, .len = 0, .alloc = 0};
    int x, y;
 
-   EINA_SAFETY_ON_NULL_RETURN_VAL(sd, NULL);
-   termpty_backlog_lock();
-   for (y = c1y; y <= c2y; y++)
+   for (y = from; y <= to; y++)
      {
         Termcell *cells;
         ssize_t w;
@@ -2073,15 +2465,14 @@ termio_selection_get(Evas_Object *obj, int c1x, int c1y, int c2x, int c2y,
         cells = termpty_cellrow_get(sd->pty, y, &w);
         if (!cells || !w)
           {
-             if (_sb_add(&sb, "\n", 1) < 0) goto err;
+             termio_export_newline(e);
              continue;
           }
         if (w > sd->grid.w) w = sd->grid.w;
+        termio_export_row_set(e, cells, w);
         if (y == c1y && c1x >= w)
           {
-             if (rtrim)
-               _sb_spaces_rtrim(&sb);
-             if (_sb_add(&sb, "\n", 1) < 0) goto err;
+             termio_export_newline(e);
              continue;
           }
         start_x = c1x;
@@ -2110,16 +2501,12 @@ termio_selection_get(Evas_Object *obj, int c1x, int c1y, int c2x, int c2y,
                {
                   last0 = -1;
                   if ((y != c2y) || (x != end_x))
-                    {
-                       if (rtrim)
-                         _sb_spaces_rtrim(&sb);
-                       if (_sb_add(&sb, "\n", 1) < 0) goto err;
-                    }
+                    termio_export_newline(e);
                   break;
                }
              else if (cells[x].att.tab)
                {
-                  if (_sb_add(&sb, "\t", 1) < 0) goto err;
+                  termio_export_tab(e);
                   x = ((x + 8) / 8) * 8;
                   x--; /* counter the ++ of the for loop */
                }
@@ -2129,31 +2516,17 @@ termio_selection_get(Evas_Object *obj, int c1x, int c1y, int c2x, int c2y,
                }
              else
                {
-                  char txt[8];
-                  int txtlen;
-
                   if (last0 >= 0)
                     {
-                       v = x - last0 - 1;
+                       termio_export_spaces(e, x - last0);
                        last0 = -1;
-                       while (v >= 0)
-                         {
-                            if (_sb_add(&sb, " ", 1) < 0) goto err;
-                            v--;
-                         }
                     }
-                  txtlen = codepoint_to_utf8(cells[x].codepoint, txt);
-                  if (txtlen > 0)
-                    if (_sb_add(&sb, txt, txtlen) < 0) goto err;
+                  termio_export_cell(e, x);
                   if ((x == (w - 1)) &&
                       ((x != c2x) || (y != c2y)))
                     {
                        if (!cells[x].att.autowrapped)
-                         {
-                            if (rtrim)
-                              _sb_spaces_rtrim(&sb);
-                            if (_sb_add(&sb, "\n", 1) < 0) goto err;
-                         }
+                         termio_export_newline(e);
                     }
                }
           }
@@ -2183,14 +2556,10 @@ termio_selection_get(Evas_Object *obj, int c1x, int c1y, int c2x, int c2y,
                          }
                     }
                   if (!have_more)
-                    {
-                       if (rtrim)
-                         _sb_spaces_rtrim(&sb);
-                       if (_sb_add(&sb, "\n", 1) < 0) goto err;
-                    }
+                    termio_export_newline(e);
                   else
                     {
-                       for (x = last0; x <= end_x; x++)
+                       for (x = last0, v = 0; x <= end_x; x++, v++)
                          {
 #if defined(SUPPORT_DBLWIDTH)
                             if ((cells[x].codepoint == 0) &&
@@ -2201,33 +2570,60 @@ termio_selection_get(Evas_Object *obj, int c1x, int c1y, int c2x, int c2y,
                               }
 #endif
                             if (x >= w) break;
-                            if (_sb_add(&sb, " ", 1) < 0) goto err;
                          }
+                       termio_export_spaces(e, v);
                     }
                }
              else
-               {
-                  if (rtrim)
-                    _sb_spaces_rtrim(&sb);
-                  if (_sb_add(&sb, "\n", 1) < 0) goto err;
-               }
+               termio_export_newline(e);
           }
      }
-   termpty_backlog_unlock();
+}
 
-   if (rtrim)
-     _sb_spaces_rtrim(&sb);
+/* writes the text from c1x,c1y to c2x,c2y to e, the backlog being locked */
+static void
+_selection_export(Termio *sd, Termio_Export *e,
+                  int c1x, int c1y, int c2x, int c2y)
+{
+   _selection_export_rows(sd, e, c1x, c1y, c2x, c2y, c1y, c2y);
+}
 
-   if (lenp)
-     *lenp = sb.len;
+char *
+termio_selection_get(Evas_Object *obj, int c1x, int c1y, int c2x, int c2y,
+                     size_t *lenp,
+                     Eina_Bool rtrim)
+{
+   Termio *sd = evas_object_smart_data_get(obj);
+   Termio_Export_String str = { NULL, 0, 0 };
+   Termio_Export *e;
+   char *s;
 
-   return sb.buf;
-err:
-   free(sb.buf);
-   return NULL;
+   EINA_SAFETY_ON_NULL_RETURN_VAL(sd, NULL);
+   e = termio_export_new(TERMIO_EXPORT_TEXT, rtrim,
+                         termio_export_string_write, &str);
+   if (!e) return NULL;
+   termpty_backlog_lock(sd->pty);
+   _selection_export(sd, e, c1x, c1y, c2x, c2y);
+   termpty_backlog_unlock(sd->pty);
+   if (!termio_export_end(e))
+     {
+        free(str.buf);
+        return NULL;
+     }
+   /* growing it went past what it needs */
+   s = str.buf;
+   if ((s) && (str.size > str.len + 1))
+     {
+        s = realloc(str.buf, str.len + 1);
+        if (!s) s = str.buf;
+     }
+   if (lenp)
+     *lenp = str.len;
+   return s;
 }
 
 
+
 static void
 _sel_set(Termio *sd, Eina_Bool enable)
 {
@@ -2461,7 +2857,7 @@ _sel_line(Termio *sd, int cy)
    ssize_t w = 0;
    Termcell *cells;
 
-   termpty_backlog_lock();
+   termpty_backlog_lock(sd->pty);
 
    _sel_set(sd, EINA_TRUE);
    sd->pty->selection.makesel = EINA_FALSE;
@@ -2495,7 +2891,7 @@ _sel_line(Termio *sd, int cy)
    sd->pty->selection.by_line = EINA_TRUE;
    sd->pty->selection.is_top_to_bottom = EINA_TRUE;
 
-   termpty_backlog_unlock();
+   termpty_backlog_unlock(sd->pty);
 }
 
 static void
@@ -2893,7 +3289,7 @@ _sel_word(Termio *sd, int cx, int cy)
    ssize_t w = 0;
    Eina_Bool done = EINA_FALSE;
 
-   termpty_backlog_lock();
+   termpty_backlog_lock(sd->pty);
 
    _sel_set(sd, EINA_TRUE);
    sd->pty->selection.makesel = EINA_TRUE;
@@ -3003,7 +3399,7 @@ _sel_word(Termio *sd, int cx, int cy)
    sd->pty->selection.is_top_to_bottom = EINA_TRUE;
    _trim_sel_word(sd);
 
-   termpty_backlog_unlock();
+   termpty_backlog_unlock(sd->pty);
 }
 
 static void
@@ -3318,7 +3714,7 @@ _selection_dbl_fix(Termio *sd
         INT_SWAP(start_x, end_x);
      }
 
-   termpty_backlog_lock();
+   termpty_backlog_lock(sd->pty);
    cells = termpty_cellrow_get(sd->pty, end_y - sd->scroll, &w);
    if (cells)
      {
@@ -3371,7 +3767,7 @@ _selection_dbl_fix(Termio *sd
                }
           }
      }
-   termpty_backlog_unlock();
+   termpty_backlog_unlock(sd->pty);
 
    if (!sd->pty->selection.is_top_to_bottom)
      {
@@ -3398,7 +3794,7 @@ _selection_newline_extend_fix(Evas_Object *obj)
    if ((sd->top_left) || (sd->bottom_right) || (sd->pty->selection.is_box))
      return;
 
-   termpty_backlog_lock();
+   termpty_backlog_lock(sd->pty);
 
    start_x = sd->pty->selection.start.x;
    start_y = sd->pty->selection.start.y;
@@ -3443,7 +3839,7 @@ _selection_newline_extend_fix(Evas_Object *obj)
    sd->pty->selection.end.x = end_x;
    sd->pty->selection.end.y = end_y;
 
-   termpty_backlog_unlock();
+   termpty_backlog_unlock(sd->pty);
 }
 
 /* }}} */
@@ -3475,6 +3871,17 @@ _imf_cursor_set(Termio *sd)
     */
 }
 
+static void
+_smart_cb_render_post(void *data, Evas *e EINA_UNUSED,
+                      void *event EINA_UNUSED)
+{
+   Termio *sd = evas_object_smart_data_get(data);
+
+   EINA_SAFETY_ON_NULL_RETURN(sd);
+   if ((sd->pty) && (sd->pty->latency))
+     termpty_latency_stage(sd->pty->latency, TERMPTY_LATENCY_RENDER);
+}
+
 static void
 _smart_cb_focus_in(void *data, Evas *e EINA_UNUSED,
                    Evas_Object *obj EINA_UNUSED, void *event EINA_UNUSED)
@@ -3486,6 +3893,7 @@ _smart_cb_focus_in(void *data, Evas *e EINA_UNUSED,
      edje_object_signal_emit(sd->cursor.obj, "focus,in,noblink", "terminology");
    else
      edje_object_signal_emit(sd->cursor.obj, "focus,in", "terminology");
+   termpty_save_focus_set(sd->pty);
    if (!sd->win) return;
    elm_win_keyboard_mode_set(sd->win, ELM_WIN_KEYBOARD_TERMINAL);
    if (sd->khdl.imf)
@@ -3533,15 +3941,14 @@ _smart_mouseover_apply(Evas_Object *obj)
    config = sd->config;
    if (!config->active_links) return;
 
-   if ((sd->mouse.cx < 0) || (sd->mouse.cy < 0) ||
+   if ((sd->mouse.cx < 0) || (sd->mouse.cy < 0) || (sd->filter.on) ||
        (sd->link.suspend) || (!evas_object_focus_get(obj)))
      {
         _remove_links(sd, obj);
         return;
      }
 
-   s = _termio_link_find(obj, sd->mouse.cx, sd->mouse.cy,
-                         &x1, &y1, &x2, &y2);
+   s = _linkmap_find(sd, sd->mouse.cx, sd->mouse.cy, &x1, &y1, &x2, &y2);
    if (!s)
      {
         _remove_links(sd, obj);
@@ -3582,6 +3989,66 @@ _smart_xy_to_cursor(Termio *sd, Evas_Coord x, Evas_Coord y,
    else if (*cy >= sd->grid.h) *cy = sd->grid.h - 1;
 }
 
+/* Motion reports are held until the next frame and only the latest one
+ * is written, unless it reports the same cell as the one before.  Other
+ * reports write out the pending motion first, in the same write, so that
+ * the application sees events in the order they happened. */
+static void
+_rep_mouse_write(Termio *sd, const char *buf, int len)
+{
+   char out[sizeof(sd->mouse.motion.buf) + 64];
+   int n = 0;
+
+   if (sd->mouse.motion.anim)
+     {
+        ecore_animator_del(sd->mouse.motion.anim);
+        sd->mouse.motion.anim = NULL;
+     }
+   if ((sd->mouse.motion.len > 0) &&
+       ((sd->mouse.motion.len != sd->mouse.motion.last_len) ||
+        (memcmp(sd->mouse.motion.buf, sd->mouse.motion.last,
+                sd->mouse.motion.len))))
+     {
+        memcpy(out, sd->mouse.motion.buf, sd->mouse.motion.len);
+        n = sd->mouse.motion.len;
+        memcpy(sd->mouse.motion.last, out, n);
+        sd->mouse.motion.last_len = n;
+     }
+   sd->mouse.motion.len = 0;
+   if ((len > 0) && (len <= 64))
+     {
+        memcpy(out + n, buf, len);
+        n += len;
+        /* buttons changed, whatever motion comes next is news */
+        sd->mouse.motion.last_len = 0;
+     }
+   if (n > 0) termpty_write(sd->pty, out, n);
+}
+
+static Eina_Bool
+_rep_mouse_motion_cb(void *data)
+{
+   Termio *sd = data;
+
+   sd->mouse.motion.anim = NULL;
+   if ((sd->pty->mouse_mode == MOUSE_NORMAL_BTN_MOVE) ||
+       (sd->pty->mouse_mode == MOUSE_NORMAL_ALL_MOVE))
+     _rep_mouse_write(sd, NULL, 0);
+   else
+     sd->mouse.motion.len = 0;
+   return ECORE_CALLBACK_CANCEL;
+}
+
+static void
+_rep_mouse_motion_queue(Termio *sd, const char *buf, int len)
+{
+   if (len > (int)sizeof(sd->mouse.motion.buf)) return;
+   memcpy(sd->mouse.motion.buf, buf, len);
+   sd->mouse.motion.len = len;
+   if (!sd->mouse.motion.anim)
+     sd->mouse.motion.anim = ecore_animator_add(_rep_mouse_motion_cb, sd);
+}
+
 static Eina_Bool
 _rep_mouse_down(Termio *sd, Evas_Event_Mouse_Down *ev, int cx, int cy)
 {
@@ -3613,7 +4080,7 @@ _rep_mouse_down(Termio *sd, Evas_Event_Mouse_Down *ev, int cx, int cy)
                        buf[4] = cx + 1 + ' ';
                        buf[5] = cy + 1 + ' ';
                        buf[6] = 0;
-                       termpty_write(sd->pty, buf, strlen(buf));
+                       _rep_mouse_write(sd, buf, strlen(buf));
                        ret = EINA_TRUE;
                     }
                }
@@ -3629,7 +4096,7 @@ _rep_mouse_down(Termio *sd, Evas_Event_Mouse_Down *ev, int cx, int cy)
                   buf[4] = cx + 1 + ' ';
                   buf[5] = cy + 1 + ' ';
                   buf[6] = 0;
-                  termpty_write(sd->pty, buf, strlen(buf));
+                  _rep_mouse_write(sd, buf, strlen(buf));
                   ret = EINA_TRUE;
                }
           }
@@ -3660,7 +4127,7 @@ _rep_mouse_down(Termio *sd, Evas_Event_Mouse_Down *ev, int cx, int cy)
                    buf[i++] = 0x80 + (v & 0x3f);
                }
              buf[i] = 0;
-             termpty_write(sd->pty, buf, strlen(buf));
+             _rep_mouse_write(sd, buf, strlen(buf));
              ret = EINA_TRUE;
           }
         break;
@@ -3671,7 +4138,7 @@ _rep_mouse_down(Termio *sd, Evas_Event_Mouse_Down *ev, int cx, int cy)
              if (btn > 2) btn = 0;
              snprintf(buf, sizeof(buf), "%c[<%i;%i;%iM", 0x1b,
                       (btn | meta), cx + 1, cy + 1);
-             termpty_write(sd->pty, buf, strlen(buf));
+             _rep_mouse_write(sd, buf, strlen(buf));
              ret = EINA_TRUE;
           }
         break;
@@ -3683,7 +4150,7 @@ _rep_mouse_down(Termio *sd, Evas_Event_Mouse_Down *ev, int cx, int cy)
              snprintf(buf, sizeof(buf), "%c[%i;%i;%iM", 0x1b,
                       (btn | meta) + ' ',
                       cx + 1, cy + 1);
-             termpty_write(sd->pty, buf, strlen(buf));
+             _rep_mouse_write(sd, buf, strlen(buf));
              ret = EINA_TRUE;
           }
         break;
@@ -3720,7 +4187,7 @@ _rep_mouse_up(Termio *sd, Evas_Event_Mouse_Up *ev, int cx, int cy)
              buf[4] = cx + 1 + ' ';
              buf[5] = cy + 1 + ' ';
              buf[6] = 0;
-             termpty_write(sd->pty, buf, strlen(buf));
+             _rep_mouse_write(sd, buf, strlen(buf));
              ret = EINA_TRUE;
           }
         break;
@@ -3748,7 +4215,7 @@ _rep_mouse_up(Termio *sd, Evas_Event_Mouse_Up *ev, int cx, int cy)
                    buf[i++] = 0x80 + (v & 0x3f);
                }
              buf[i] = 0;
-             termpty_write(sd->pty, buf, strlen(buf));
+             _rep_mouse_write(sd, buf, strlen(buf));
              ret = EINA_TRUE;
           }
         break;
@@ -3758,7 +4225,7 @@ _rep_mouse_up(Termio *sd, Evas_Event_Mouse_Up *ev, int cx, int cy)
              if (btn > 2) btn = 0;
              snprintf(buf, sizeof(buf), "%c[<%i;%i;%im", 0x1b,
                       (btn | meta), cx + 1, cy + 1);
-             termpty_write(sd->pty, buf, strlen(buf));
+             _rep_mouse_write(sd, buf, strlen(buf));
              ret = EINA_TRUE;
           }
         break;
@@ -3767,7 +4234,7 @@ _rep_mouse_up(Termio *sd, Evas_Event_Mouse_Up *ev, int cx, int cy)
              snprintf(buf, sizeof(buf), "%c[%i;%i;%iM", 0x1b,
                       (3 | meta) + ' ',
                       cx + 1, cy + 1);
-             termpty_write(sd->pty, buf, strlen(buf));
+             _rep_mouse_write(sd, buf, strlen(buf));
              ret = EINA_TRUE;
           }
         break;
@@ -3808,7 +4275,7 @@ _rep_mouse_move(Termio *sd, Evas_Event_Mouse_Move *ev, int cx, int cy)
              buf[4] = cx + 1 + ' ';
              buf[5] = cy + 1 + ' ';
              buf[6] = 0;
-             termpty_write(sd->pty, buf, strlen(buf));
+             _rep_mouse_motion_queue(sd, buf, strlen(buf));
              ret = EINA_TRUE;
           }
         break;
@@ -3837,7 +4304,7 @@ _rep_mouse_move(Termio *sd, Evas_Event_Mouse_Move *ev, int cx, int cy)
                    buf[i++] = 0x80 + (v & 0x3f);
                }
              buf[i] = 0;
-             termpty_write(sd->pty, buf, strlen(buf));
+             _rep_mouse_motion_queue(sd, buf, strlen(buf));
              ret = EINA_TRUE;
           }
         break;
@@ -3845,7 +4312,7 @@ _rep_mouse_move(Termio *sd, Evas_Event_Mouse_Move *ev, int cx, int cy)
           {
              snprintf(buf, sizeof(buf), "%c[<%i;%i;%iM", 0x1b,
                       (btn | meta | 32), cx + 1, cy + 1);
-             termpty_write(sd->pty, buf, strlen(buf));
+             _rep_mouse_motion_queue(sd, buf, strlen(buf));
              ret = EINA_TRUE;
           }
         break;
@@ -3855,7 +4322,7 @@ _rep_mouse_move(Termio *sd, Evas_Event_Mouse_Move *ev, int cx, int cy)
              snprintf(buf, sizeof(buf), "%c[%i;%i;%iM", 0x1b,
                       (btn | meta | 32) + ' ',
                       cx + 1, cy + 1);
-             termpty_write(sd->pty, buf, strlen(buf));
+             _rep_mouse_motion_queue(sd, buf, strlen(buf));
              ret = EINA_TRUE;
           }
         break;
@@ -4516,7 +4983,7 @@ _smart_cb_mouse_wheel(void *data, Evas *e EINA_UNUSED, Evas_Object *obj EINA_UNU
                  buf[4] = cx + 1 + ' ';
                  buf[5] = cy + 1 + ' ';
                  buf[6] = 0;
-                 termpty_write(sd->pty, buf, strlen(buf));
+                 _rep_mouse_write(sd, buf, strlen(buf));
               }
             break;
           case MOUSE_EXT_UTF8: // ESC.[.M.BTN/FLGS.XUTF8.YUTF8
@@ -4544,7 +5011,7 @@ _smart_cb_mouse_wheel(void *data, Evas *e EINA_UNUSED, Evas_Object *obj EINA_UNU
                        buf[i++] = 0x80 + (v & 0x3f);
                    }
                  buf[i] = 0;
-                 termpty_write(sd->pty, buf, strlen(buf));
+                 _rep_mouse_write(sd, buf, strlen(buf));
               }
             break;
           case MOUSE_EXT_SGR: // ESC.[.<.NUM.;.NUM.;.NUM.M
@@ -4552,7 +5019,7 @@ _smart_cb_mouse_wheel(void *data, Evas *e EINA_UNUSED, Evas_Object *obj EINA_UNU
                  int btn = (ev->z >= 0) ? 1 + 64 : 64;
                  snprintf(buf, sizeof(buf), "%c[<%i;%i;%iM", 0x1b,
                           btn, cx + 1, cy + 1);
-                 termpty_write(sd->pty, buf, strlen(buf));
+                 _rep_mouse_write(sd, buf, strlen(buf));
               }
             break;
           case MOUSE_EXT_URXVT: // ESC.[.NUM.;.NUM.;.NUM.M
@@ -4561,7 +5028,7 @@ _smart_cb_mouse_wheel(void *data, Evas *e EINA_UNUSED, Evas_Object *obj EINA_UNU
                  snprintf(buf, sizeof(buf), "%c[%i;%i;%iM", 0x1b,
                           btn + ' ',
                           cx + 1, cy + 1);
-                 termpty_write(sd->pty, buf, strlen(buf));
+                 _rep_mouse_write(sd, buf, strlen(buf));
               }
             break;
           default:
@@ -4571,18 +5038,385 @@ _smart_cb_mouse_wheel(void *data, Evas *e EINA_UNUSED, Evas_Object *obj EINA_UNU
 }
 
 /* }}} */
-/* {{{ Gestures */
+/* {{{ Search */
 
-static Evas_Event_Flags
-_smart_cb_gest_long_move(void *data, void *event EINA_UNUSED)
+static void
+_search_cb(void *data, const Termio_Search_Match *m,
+           Eina_Bool done EINA_UNUSED)
 {
-//   Elm_Gesture_Taps_Info *p = event;
-   Termio *sd = evas_object_smart_data_get(data);
+   Evas_Object *obj = data;
+   Termio *sd = evas_object_smart_data_get(obj);
 
-   EINA_SAFETY_ON_NULL_RETURN_VAL(sd, EVAS_EVENT_FLAG_ON_HOLD);
-   evas_object_smart_callback_call(data, "options", NULL);
-   sd->didclick = EINA_TRUE;
-   return EVAS_EVENT_FLAG_ON_HOLD;
+   EINA_SAFETY_ON_NULL_RETURN(sd);
+   _drawn_reset(sd);
+   if (m)
+     {
+        sd->search.cur = *m;
+        sd->search.found = EINA_TRUE;
+        /* bring the match to the middle of the view if hidden */
+        if ((m->y1 + sd->scroll < 0) || (m->y1 + sd->scroll >= sd->grid.h))
+          {
+             int scroll = (sd->grid.h / 2) - m->y1;
+
+             if (scroll < 0) scroll = 0;
+             miniview_position_offset(term_miniview_get(sd->term),
+                                      sd->scroll - scroll, EINA_TRUE);
+             sd->scroll = scroll;
+             _remove_links(sd, obj);
+          }
+     }
+   /* more matches to highlight */
+   _smart_update_queue(obj, sd);
+}
+
+static void
+_search_from(Termio *sd, int x, int y)
+{
+   if (sd->search.found)
+     {
+        x = sd->search.cur.x1;
+        y = sd->search.cur.y1;
+     }
+   termio_search_start(sd->search.s, x, y, sd->search.dir);
+}
+
+static Eina_Bool
+_search_is_current(const Termio *sd, int x, int y)
+{
+   const Termio_Search_Match *cur = &sd->search.cur;
+
+   if ((!sd->search.found) || (y < cur->y1) || (y > cur->y2))
+     return EINA_FALSE;
+   return (y == cur->y1) ? (x == cur->x1) : (x == 0);
+}
+
+Eina_Bool
+termio_search(Evas_Object *obj, const char *needle, int flags, int dir)
+{
+   Termio *sd = evas_object_smart_data_get(obj);
+
+   EINA_SAFETY_ON_NULL_RETURN_VAL(sd, EINA_FALSE);
+   if ((!needle) || (!needle[0]))
+     {
+        termio_search_clear(obj);
+        return EINA_TRUE;
+     }
+   if ((sd->search.needle) && (!strcmp(sd->search.needle, needle)) &&
+       (sd->search.flags == flags) && (sd->search.dir == dir))
+     return EINA_TRUE;
+   if (!sd->search.s)
+     sd->search.s = termio_search_new(sd->pty, _search_cb, obj);
+   if (!sd->search.s) return EINA_FALSE;
+   if (!termio_search_needle_set(sd->search.s, needle, flags))
+     {
+        /* most likely a regex being typed */
+        DBG("invalid search '%s'", needle);
+        _smart_update_queue(obj, sd);
+        return EINA_FALSE;
+     }
+   eina_stringshare_replace(&sd->search.needle, needle);
+   sd->search.flags = flags;
+   sd->search.dir = (dir < 0) ? -1 : 1;
+   _drawn_reset(sd);
+   /* incremental: look again from the current match, as it may still be
+    * one with a longer needle */
+   if (sd->search.dir < 0)
+     _search_from(sd, sd->grid.w, sd->grid.h - 1 - sd->scroll);
+   else
+     _search_from(sd, 0, -sd->scroll);
+   sd->search.found = EINA_FALSE;
+   _smart_update_queue(obj, sd);
+   return EINA_TRUE;
+}
+
+Eina_Bool
+termio_search_next(Evas_Object *obj, Eina_Bool backward)
+{
+   Termio *sd = evas_object_smart_data_get(obj);
+   int dir;
+
+   EINA_SAFETY_ON_NULL_RETURN_VAL(sd, EINA_FALSE);
+   if (termio_search_needle_empty(sd->search.s)) return EINA_FALSE;
+   dir = backward ? -sd->search.dir : sd->search.dir;
+   /* regex matches are all known already */
+   if ((sd->search.found) &&
+       (termio_search_match_next(sd->search.s, &sd->search.cur, dir)))
+     return EINA_TRUE;
+   if (sd->search.found)
+     termio_search_start(sd->search.s,
+                         sd->search.cur.x1 + dir, sd->search.cur.y1, dir);
+   else if (dir < 0)
+     termio_search_start(sd->search.s,
+                         sd->grid.w, sd->grid.h - 1 - sd->scroll, dir);
+   else
+     termio_search_start(sd->search.s, 0, -sd->scroll, dir);
+   return EINA_TRUE;
+}
+
+Eina_Bool
+termio_search_cancel(Evas_Object *obj)
+{
+   Termio *sd = evas_object_smart_data_get(obj);
+
+   EINA_SAFETY_ON_NULL_RETURN_VAL(sd, EINA_FALSE);
+   if (!termio_search_running(sd->search.s)) return EINA_FALSE;
+   termio_search_stop(sd->search.s);
+   return EINA_TRUE;
+}
+
+void
+termio_search_clear(Evas_Object *obj)
+{
+   Termio *sd = evas_object_smart_data_get(obj);
+
+   EINA_SAFETY_ON_NULL_RETURN(sd);
+   if (!sd->search.s) return;
+   termio_search_free(sd->search.s);
+   sd->search.s = NULL;
+   eina_stringshare_replace(&sd->search.needle, NULL);
+   sd->search.found = EINA_FALSE;
+   _drawn_reset(sd);
+   _smart_update_queue(obj, sd);
+}
+
+/* {{{ Filter */
+
+/* Only the logical lines matching the filter are shown, the most recent
+ * at the bottom.  Lines of the backlog are only looked at once: the
+ * matching rows are kept in sd->filter.rows and sd->filter.done tells
+ * where to go on from when more output comes in.  The last lines, that
+ * are on the screen or still growing, are matched again for every
+ * frame. */
+
+static void
+_filter_search_cb(void *data EINA_UNUSED,
+                  const Termio_Search_Match *m EINA_UNUSED,
+                  Eina_Bool done EINA_UNUSED)
+{
+}
+
+/* looks at the logical line starting at row y and ending before y_end,
+ * returns where the next one starts or y_end if it may go on further */
+static int
+_filter_line_match(Termio *sd, int y, int y_end, Eina_Bool *match)
+{
+   Termpty *ty = sd->pty;
+   int len = 0;
+
+   *match = EINA_FALSE;
+   while (y < y_end)
+     {
+        Termcell *cells;
+        ssize_t w = 0;
+        int back_y = termpty_backlog_row_get(ty, y);
+
+        cells = termpty_cellrow_get(ty, y, &w);
+        y++;
+        if ((!cells) || (w <= 0)) break;
+        if (len + w > sd->filter.line_size)
+          {
+             Termcell *tmp;
+             int size = len + w + ty->w;
+
+             tmp = realloc(sd->filter.line, size * sizeof(Termcell));
+             if (!tmp) break;
+             sd->filter.line = tmp;
+             sd->filter.line_size = size;
+          }
+        memcpy(&sd->filter.line[len], cells, w * sizeof(Termcell));
+        len += w;
+        /* backlog rows may have been cut at another width */
+        if ((back_y > 0) && (termpty_backlog_row_get(ty, y) == back_y))
+          continue;
+        if ((w < ty->w) || (!cells[w - 1].att.autowrapped)) break;
+     }
+   if (len > 0)
+     *match = termio_search_line_match(sd->filter.s, sd->filter.line, len);
+   return y;
+}
+
+static void
+_filter_row_add(Termio *sd, long row)
+{
+   if (sd->filter.nrows == sd->filter.rows_size)
+     {
+        long *tmp;
+        int size = sd->filter.rows_size ? sd->filter.rows_size * 2 : 64;
+
+        tmp = realloc(sd->filter.rows, size * sizeof(long));
+        if (!tmp) return;
+        sd->filter.rows = tmp;
+        sd->filter.rows_size = size;
+     }
+   sd->filter.rows[sd->filter.nrows++] = row;
+}
+
+static void
+_filter_tail_add(Termio *sd, int y)
+{
+   if (sd->filter.ntail == sd->filter.tail_size)
+     {
+        int *tmp;
+        int size = sd->filter.tail_size ? sd->filter.tail_size * 2 : 64;
+
+        tmp = realloc(sd->filter.tail, size * sizeof(int));
+        if (!tmp) return;
+        sd->filter.tail = tmp;
+        sd->filter.tail_size = size;
+     }
+   sd->filter.tail[sd->filter.ntail++] = y;
+}
+
+/* called with the backlog locked */
+static void
+_filter_update(Termio *sd)
+{
+   Termpty *ty = sd->pty;
+   long pushed = ty->backlog_pushed;
+   long oldest = pushed - termpty_backlog_length(ty);
+   int i, y, next;
+   Eina_Bool match;
+
+   /* forget about the rows that left the backlog */
+   for (i = 0; (i < sd->filter.nrows) && (sd->filter.rows[i] < oldest); i++);
+   if (i > 0)
+     {
+        sd->filter.nrows -= i;
+        memmove(sd->filter.rows, sd->filter.rows + i,
+                sd->filter.nrows * sizeof(long));
+     }
+   if (sd->filter.done < oldest) sd->filter.done = oldest;
+
+   /* lines that made it to the backlog since last time */
+   for (y = sd->filter.done - pushed; y < 0; y = next)
+     {
+        next = _filter_line_match(sd, y, 0, &match);
+        if (next == 0)
+          {
+             Termcell *cells;
+             ssize_t w = 0;
+
+             /* goes on on the screen */
+             cells = termpty_cellrow_get(ty, -1, &w);
+             if ((cells) && (w == ty->w) && (cells[w - 1].att.autowrapped))
+               break;
+          }
+        if (match)
+          for (i = y; i < next; i++) _filter_row_add(sd, pushed + i);
+        sd->filter.done = pushed + next;
+     }
+
+   sd->filter.ntail = 0;
+   for (y = sd->filter.done - pushed; y < ty->h; y = next)
+     {
+        next = _filter_line_match(sd, y, ty->h, &match);
+        if (match)
+          for (i = y; i < next; i++) _filter_tail_add(sd, i);
+     }
+}
+
+/* row shown on line y of the view, in termpty_cellrow_get() coordinates,
+ * or INT_MIN */
+static int
+_filter_row_get(const Termio *sd, int y)
+{
+   int n = sd->filter.nrows + sd->filter.ntail;
+   int i = y;
+
+   if (n > sd->grid.h) i += n - sd->grid.h - sd->scroll;
+   if ((i < 0) || (i >= n)) return INT_MIN;
+   if (i < sd->filter.nrows)
+     return sd->filter.rows[i] - sd->pty->backlog_pushed;
+   return sd->filter.tail[i - sd->filter.nrows];
+}
+
+static void
+_filter_reset(Termio *sd)
+{
+   sd->filter.nrows = 0;
+   sd->filter.ntail = 0;
+   sd->filter.done = LONG_MIN;
+}
+
+/* shows only the lines matching needle, or all of them again if needle
+ * is NULL or empty.  What was matched so far is kept, so filtering with
+ * the same needle again only looks at new lines */
+Eina_Bool
+termio_filter(Evas_Object *obj, const char *needle, int flags)
+{
+   Termio *sd = evas_object_smart_data_get(obj);
+
+   EINA_SAFETY_ON_NULL_RETURN_VAL(sd, EINA_FALSE);
+   if ((!needle) || (!needle[0]))
+     {
+        if (!sd->filter.on) return EINA_TRUE;
+        sd->filter.on = EINA_FALSE;
+        sd->scroll = 0;
+        _drawn_reset(sd);
+        _smart_update_queue(obj, sd);
+        return EINA_TRUE;
+     }
+   if ((!sd->filter.needle) || (strcmp(sd->filter.needle, needle)) ||
+       (sd->filter.flags != flags))
+     {
+        if (!sd->filter.s)
+          sd->filter.s = termio_search_new(sd->pty, _filter_search_cb, obj);
+        if (!sd->filter.s) return EINA_FALSE;
+        if (!termio_search_needle_set(sd->filter.s, needle, flags))
+          {
+             DBG("invalid filter '%s'", needle);
+             return EINA_FALSE;
+          }
+        eina_stringshare_replace(&sd->filter.needle, needle);
+        sd->filter.flags = flags;
+        _filter_reset(sd);
+     }
+   if (!sd->filter.on)
+     {
+        sd->filter.on = EINA_TRUE;
+        _sel_set(sd, EINA_FALSE);
+        _remove_links(sd, obj);
+     }
+   sd->scroll = 0;
+   _smart_update_queue(obj, sd);
+   return EINA_TRUE;
+}
+
+/* goes back and forth between the filtered view and the normal one */
+Eina_Bool
+termio_filter_toggle(Evas_Object *obj)
+{
+   Termio *sd = evas_object_smart_data_get(obj);
+
+   EINA_SAFETY_ON_NULL_RETURN_VAL(sd, EINA_FALSE);
+   if (sd->filter.on)
+     return termio_filter(obj, NULL, 0);
+   if (!sd->filter.needle) return EINA_FALSE;
+   return termio_filter(obj, sd->filter.needle, sd->filter.flags);
+}
+
+Eina_Bool
+termio_filter_active_get(const Evas_Object *obj)
+{
+   Termio *sd = evas_object_smart_data_get(obj);
+
+   EINA_SAFETY_ON_NULL_RETURN_VAL(sd, EINA_FALSE);
+   return sd->filter.on;
+}
+
+/* }}} */
+/* {{{ Gestures */
+
+static Evas_Event_Flags
+_smart_cb_gest_long_move(void *data, void *event EINA_UNUSED)
+{
+//   Elm_Gesture_Taps_Info *p = event;
+   Termio *sd = evas_object_smart_data_get(data);
+
+   EINA_SAFETY_ON_NULL_RETURN_VAL(sd, EVAS_EVENT_FLAG_ON_HOLD);
+   evas_object_smart_callback_call(data, "options", NULL);
+   sd->didclick = EINA_TRUE;
+   return EVAS_EVENT_FLAG_ON_HOLD;
 }
 
 static Evas_Event_Flags
@@ -4663,6 +5497,307 @@ _smart_cb_gest_zoom_abort(void *data, void *event EINA_UNUSED)
 /* }}} */
 /* {{{ Smart */
 
+#define DRAWN_VALID   (1 << 0) /* converted from the row named below */
+#define DRAWN_BACKLOG (1 << 1) /* from the backlog, and no longer changing */
+#define DRAWN_KEEP    (1 << 2) /* nothing to do in this frame */
+
+/* A textgrid row y was converted from backlog_pushed + y - scroll as they
+ * were then.  When the view moves by a few rows, whether by scrolling or
+ * by output pushing rows into the backlog, most rows are only to be moved
+ * up or down: they are copied in the textgrid and only the rows coming
+ * into view are converted again.  Rows of the screen are only kept when
+ * the pty did not change since, as anything on it may have, and so is the
+ * last row of the backlog while its line can still grow, see
+ * termpty_backlog_row_open() */
+static void
+_drawn_reset(Termio *sd)
+{
+   sd->drawn.valid = EINA_FALSE;
+}
+
+static int
+_drawn_shift(Termio *sd, int inv)
+{
+   Termpty *ty = sd->pty;
+   unsigned char *flags = sd->drawn.flags;
+   long oldest;
+   int h = sd->grid.h, d, y, y_old, first, last, step;
+
+   if ((!sd->drawn.valid) || (sd->filter.on) || (sd->drawn.h != h) ||
+       (sd->drawn.inv != !!inv) ||
+       (sd->drawn.colors_gen != colors_generation_get()))
+     d = h;
+   else
+     d = (int)(ty->backlog_pushed - sd->drawn.pushed)
+       - (sd->scroll - sd->drawn.scroll);
+   if ((d >= h) || (d <= -h))
+     {
+        memset(flags, 0, h);
+        return h;
+     }
+   oldest = ty->backlog_pushed - termpty_backlog_length(ty);
+   /* in the order that does not overwrite rows still to be moved */
+   if (d >= 0)
+     {
+        first = 0;
+        last = h;
+        step = 1;
+     }
+   else
+     {
+        first = h - 1;
+        last = -1;
+        step = -1;
+     }
+   for (y = first; y != last; y += step)
+     {
+        unsigned char f = 0;
+
+        y_old = y + d;
+        if ((y_old >= 0) && (y_old < h))
+          {
+             f = flags[y_old];
+             if (!(f & DRAWN_VALID))
+               f = 0;
+             else if (f & DRAWN_BACKLOG)
+               {
+                  /* gone from the backlog, if it is still shown */
+                  if (ty->backlog_pushed + y - sd->scroll < oldest)
+                    f = 0;
+               }
+             else if (sd->drawn.screen_dirty)
+               f = 0;
+          }
+        if ((f) && (d != 0))
+          {
+             Evas_Textgrid_Cell *src, *dst;
+
+             src = evas_object_textgrid_cellrow_get(sd->grid.obj, y_old);
+             dst = evas_object_textgrid_cellrow_get(sd->grid.obj, y);
+             if ((!src) || (!dst))
+               f = 0;
+             else
+               {
+                  memcpy(dst, src, sd->grid.w * sizeof(Evas_Textgrid_Cell));
+                  evas_object_textgrid_cellrow_set(sd->grid.obj, y, dst);
+                  evas_object_textgrid_update_add(sd->grid.obj, 0, y,
+                                                  sd->grid.w, 1);
+               }
+          }
+        flags[y] = f ? (f | DRAWN_KEEP) : 0;
+     }
+   return d;
+}
+
+static void
+_linkmap_row_clear(Linkmap_Row *row)
+{
+   int i;
+
+   for (i = 0; i < row->n; i++)
+     eina_stringshare_del(row->links[i].string);
+   free(row->links);
+   row->links = NULL;
+   row->n = 0;
+   row->valid = EINA_FALSE;
+}
+
+static void
+_linkmap_free(Termio *sd)
+{
+   int y;
+
+   for (y = 0; y < sd->linkmap.h; y++)
+     _linkmap_row_clear(&sd->linkmap.rows[y]);
+   free(sd->linkmap.rows);
+   sd->linkmap.rows = NULL;
+   sd->linkmap.h = 0;
+}
+
+/* The links of a textgrid row stay with it when _drawn_shift() moves it,
+ * and are only looked for again, the first time the mouse goes over them,
+ * once the row or a row of its line has been converted again.  Lines
+ * going on past the view are looked for again whenever the view moves */
+static void
+_linkmap_shift(Termio *sd, int d)
+{
+   Linkmap_Row *rows = sd->linkmap.rows;
+   unsigned char *flags = sd->drawn.flags;
+   long base;
+   int h = sd->grid.h, y, n, i, first, last, step;
+
+   if (sd->linkmap.h != h)
+     {
+        _linkmap_free(sd);
+        sd->linkmap.rows = calloc(h, sizeof(Linkmap_Row));
+        if (sd->linkmap.rows) sd->linkmap.h = h;
+        return;
+     }
+   if ((d != 0) && (d < h) && (d > -h))
+     {
+        /* in the same order as the textgrid rows, swapping so that
+         * what a kept row held ends up on a row converted again */
+        if (d > 0)
+          {
+             first = 0;
+             last = h;
+             step = 1;
+          }
+        else
+          {
+             first = h - 1;
+             last = -1;
+             step = -1;
+          }
+        for (y = first; y != last; y += step)
+          {
+             Linkmap_Row tmp;
+
+             if (!(flags[y] & DRAWN_KEEP)) continue;
+             tmp = rows[y];
+             rows[y] = rows[y + d];
+             rows[y + d] = tmp;
+          }
+     }
+   for (y = 0; y < h; y++)
+     rows[y].stale = (!(flags[y] & DRAWN_KEEP)) ||
+       ((d != 0) && (rows[y].cut));
+   /* a changed row may also end, start or join the lines next to it */
+   base = sd->pty->backlog_pushed - sd->scroll;
+   for (y = 0; y < h; y++)
+     {
+        if (!rows[y].stale) continue;
+        for (n = y - 1; n <= y + 1; n++)
+          {
+             long top, bottom;
+
+             if ((n < 0) || (n >= h) || (!rows[n].valid)) continue;
+             top = rows[n].top - base;
+             bottom = rows[n].bottom - base;
+             if (top < 0) top = 0;
+             if (bottom > h - 1) bottom = h - 1;
+             for (i = top; i <= bottom; i++)
+               _linkmap_row_clear(&rows[i]);
+          }
+        _linkmap_row_clear(&rows[y]);
+     }
+}
+
+typedef struct _Linkmap_Build
+{
+   Linkmap_Link *links;
+   int n, size;
+   long base;
+} Linkmap_Build;
+
+static void
+_linkmap_build_cb(void *data, const char *link,
+                  int x1, int y1, int x2, int y2)
+{
+   Linkmap_Build *b = data;
+   Linkmap_Link *l;
+
+   if (b->n == b->size)
+     {
+        int size = b->size ? b->size * 2 : 8;
+        Linkmap_Link *tmp = realloc(b->links, size * sizeof(Linkmap_Link));
+
+        if (!tmp) return;
+        b->links = tmp;
+        b->size = size;
+     }
+   l = &b->links[b->n++];
+   l->string = eina_stringshare_add(link);
+   l->x1 = x1;
+   l->y1 = b->base + y1;
+   l->x2 = x2;
+   l->y2 = b->base + y2;
+}
+
+static Linkmap_Row *
+_linkmap_row_get(Termio *sd, int cy)
+{
+   Linkmap_Row *row = &sd->linkmap.rows[cy];
+   Linkmap_Build b = { NULL, 0, 0, 0 };
+   Eina_Bool cut = EINA_FALSE;
+   int top = 0, bottom = 0, y, i;
+
+   if (row->valid) return row;
+   b.base = sd->pty->backlog_pushed - sd->scroll;
+   if (!_termio_links_find(sd->self, cy, &top, &bottom, &cut,
+                           _linkmap_build_cb, &b))
+     return NULL;
+   for (y = top; y <= bottom; y++)
+     {
+        Linkmap_Row *r = &sd->linkmap.rows[y];
+        long abs_y = b.base + y;
+        int n = 0;
+
+        _linkmap_row_clear(r);
+        for (i = 0; i < b.n; i++)
+          if ((b.links[i].y1 <= abs_y) && (abs_y <= b.links[i].y2)) n++;
+        if (n > 0)
+          {
+             r->links = malloc(n * sizeof(Linkmap_Link));
+             if (!r->links) continue;
+             for (i = 0; i < b.n; i++)
+               {
+                  if ((b.links[i].y1 > abs_y) || (abs_y > b.links[i].y2))
+                    continue;
+                  r->links[r->n] = b.links[i];
+                  eina_stringshare_ref(b.links[i].string);
+                  r->n++;
+               }
+          }
+        r->top = b.base + top;
+        r->bottom = b.base + bottom;
+        r->cut = cut;
+        r->valid = EINA_TRUE;
+     }
+   for (i = 0; i < b.n; i++)
+     eina_stringshare_del(b.links[i].string);
+   free(b.links);
+   return row->valid ? row : NULL;
+}
+
+/* the link under cell cx,cy of the view.  The map only tells what the last
+ * frame shows, until then links are looked for the slow way */
+static char *
+_linkmap_find(Termio *sd, int cx, int cy,
+              int *x1r, int *y1r, int *x2r, int *y2r)
+{
+   Linkmap_Row *row;
+   long base, abs_y;
+   int i;
+
+   if ((!sd->drawn.valid) || (sd->drawn.screen_dirty) ||
+       (sd->drawn.pushed != sd->pty->backlog_pushed) ||
+       (sd->drawn.scroll != sd->scroll) || (sd->filter.on) ||
+       (sd->linkmap.h != sd->grid.h) || (sd->drawn.h != sd->grid.h))
+     return _termio_link_find(sd->self, cx, cy, x1r, y1r, x2r, y2r);
+   if ((cx < 0) || (cx >= sd->grid.w) || (cy < 0) || (cy >= sd->grid.h))
+     return NULL;
+
+   row = _linkmap_row_get(sd, cy);
+   if (!row) return NULL;
+   base = sd->pty->backlog_pushed - sd->scroll;
+   abs_y = base + cy;
+   for (i = 0; i < row->n; i++)
+     {
+        const Linkmap_Link *l = &row->links[i];
+
+        if (((abs_y == l->y1) && (cx < l->x1)) ||
+            ((abs_y == l->y2) && (cx > l->x2)))
+          continue;
+        *x1r = l->x1;
+        *y1r = l->y1 - base;
+        *x2r = l->x2;
+        *y2r = l->y2 - base;
+        return _termio_link_resolve(sd->self, l->string);
+     }
+   return NULL;
+}
+
 static void
 _smart_apply(Evas_Object *obj)
 {
@@ -4671,10 +5806,29 @@ _smart_apply(Evas_Object *obj)
    Eina_List *l, *ln;
    Termblock *blk;
    int x, y, ch1 = 0, ch2 = 0, inv = 0, preedit_x = 0, preedit_y = 0;
+   int hl_x1, hl_x2, row_y;
    ssize_t w;
 
    EINA_SAFETY_ON_NULL_RETURN(sd);
    evas_object_geometry_get(obj, &ox, &oy, &ow, &oh);
+   if (sd->row_colors_size < sd->grid.w)
+     {
+        Color_Pair *tmp = realloc(sd->row_colors,
+                                  sd->grid.w * sizeof(Color_Pair));
+
+        if (!tmp) return;
+        sd->row_colors = tmp;
+        sd->row_colors_size = sd->grid.w;
+     }
+   if (sd->drawn.h != sd->grid.h)
+     {
+        unsigned char *tmp = realloc(sd->drawn.flags, sd->grid.h);
+
+        if (!tmp) return;
+        sd->drawn.flags = tmp;
+        sd->drawn.h = sd->grid.h;
+        sd->drawn.valid = EINA_FALSE;
+     }
 
    EINA_LIST_FOREACH(sd->pty->block.active, l, blk)
      {
@@ -4682,18 +5836,43 @@ _smart_apply(Evas_Object *obj)
         blk->active = EINA_FALSE;
      }
    inv = sd->pty->termstate.reverse;
-   termpty_backlog_lock();
-   termpty_backscroll_adjust(sd->pty, &sd->scroll);
+   termpty_backlog_lock(sd->pty);
+   if (sd->filter.on)
+     {
+        int max;
+
+        _filter_update(sd);
+        max = sd->filter.nrows + sd->filter.ntail - sd->grid.h;
+        if (sd->scroll > max) sd->scroll = max;
+        if (sd->scroll < 0) sd->scroll = 0;
+     }
+   else
+     termpty_backscroll_adjust(sd->pty, &sd->scroll);
+   _linkmap_shift(sd, _drawn_shift(sd, inv));
    for (y = 0; y < sd->grid.h; y++)
      {
-        Termcell *cells;
+        Termcell *cells = NULL;
         Evas_Textgrid_Cell *tc;
+        Eina_Bool has_block = EINA_FALSE;
 
+        if (sd->drawn.flags[y] & DRAWN_KEEP)
+          {
+             sd->drawn.flags[y] &= ~DRAWN_KEEP;
+             continue;
+          }
+        sd->drawn.flags[y] = 0;
         w = 0;
-        cells = termpty_cellrow_get(sd->pty, y - sd->scroll, &w);
+        row_y = sd->filter.on ? _filter_row_get(sd, y) : y - sd->scroll;
+        if (row_y != INT_MIN)
+          cells = termpty_cellrow_get(sd->pty, row_y, &w);
         tc = evas_object_textgrid_cellrow_get(sd->grid.obj, y);
         if (!tc) continue;
+        if ((cells) && (w > 0))
+          colors_row_get(cells, MIN(w, sd->grid.w), inv, sd->row_colors);
         ch1 = -1;
+        hl_x2 = 0;
+        hl_x1 = termio_search_row_find(sd->search.s, cells, w,
+                                       row_y, 0, &hl_x2);
         for (x = 0; x < sd->grid.w; x++)
           {
              if ((!cells) || (x >= w))
@@ -4720,6 +5899,8 @@ _smart_apply(Evas_Object *obj)
                   bid = termpty_block_id_get(&(cells[x]), &bx, &by);
                   if (bid >= 0)
                     {
+                       /* blocks are to be activated again every frame */
+                       has_block = EINA_TRUE;
                        if (ch1 < 0) ch1 = x;
                        ch2 = x;
                        tc[x].codepoint = 0;
@@ -4733,17 +5914,12 @@ _smart_apply(Evas_Object *obj)
                        tc[x].double_width = 0;
 #endif
                        blk = termpty_block_get(sd->pty, bid);
-                       if (blk)
+                       /* placed from its first cell, moved once below */
+                       if ((blk) && (!blk->active))
                          {
                             _block_activate(obj, blk);
                             blk->x = (x - bx);
                             blk->y = (y - by);
-                            evas_object_move(blk->obj,
-                                             ox + (blk->x * sd->font.chw),
-                                             oy + (blk->y * sd->font.chh));
-                            evas_object_resize(blk->obj,
-                                               blk->w * sd->font.chw,
-                                               blk->h * sd->font.chh);
                          }
                     }
                   else if (cells[x].att.invisible)
@@ -4772,32 +5948,28 @@ _smart_apply(Evas_Object *obj)
                     {
                        int fg, bg, fgext, bgext, codepoint;
 
-                       // colors
-                       fg = cells[x].att.fg;
-                       bg = cells[x].att.bg;
-                       fgext = cells[x].att.fg256;
-                       bgext = cells[x].att.bg256;
+                       fg = sd->row_colors[x].fg;
+                       bg = sd->row_colors[x].bg;
+                       fgext = sd->row_colors[x].fg_ext;
+                       bgext = sd->row_colors[x].bg_ext;
                        codepoint = cells[x].codepoint;
 
-                       if ((fg == COL_DEF) && (cells[x].att.inverse ^ inv))
-                         fg = COL_INVERSEBG;
-                       if (bg == COL_DEF)
-                         {
-                            if (cells[x].att.inverse ^ inv)
-                              bg = COL_INVERSE;
-                            else if (!bgext)
-                              bg = COL_INVIS;
-                         }
-                       if ((cells[x].att.fgintense) && (!fgext)) fg += 48;
-                       if ((cells[x].att.bgintense) && (!bgext)) bg += 48;
-                       if (cells[x].att.inverse ^ inv)
+                       if ((hl_x1 >= 0) && (x >= hl_x2))
+                         hl_x1 = termio_search_row_find(sd->search.s, cells,
+                                                        w, row_y,
+                                                        hl_x2, &hl_x2);
+                       if ((hl_x1 >= 0) && (x >= hl_x1))
                          {
-                            int t;
-                            t = fgext; fgext = bgext; bgext = t;
-                            t = fg; fg = bg; bg = t;
+                            fg = COL_BLACK;
+                            if (cells[x].att.bold) fg += 12;
+                            if (cells[x].att.faint) fg += 24;
+                            if (_search_is_current(sd, hl_x1, row_y))
+                              bg = COL_GREEN;
+                            else
+                              bg = COL_YELLOW;
+                            fgext = 0;
+                            bgext = 0;
                          }
-                       if ((cells[x].att.bold) && (!fgext)) fg += 12;
-                       if ((cells[x].att.faint) && (!fgext)) fg += 24;
                        if ((tc[x].codepoint != codepoint) ||
                            (tc[x].fg != fg) ||
                            (tc[x].bg != bg) ||
@@ -4834,6 +6006,13 @@ _smart_apply(Evas_Object *obj)
         if (ch1 >= 0)
           evas_object_textgrid_update_add(sd->grid.obj, ch1, y,
                                           ch2 - ch1 + 1, 1);
+        if ((cells) && (!has_block))
+          {
+             sd->drawn.flags[y] = DRAWN_VALID;
+             if ((row_y < 0) &&
+                 (!termpty_backlog_row_open(sd->pty, row_y, cells, w)))
+               sd->drawn.flags[y] |= DRAWN_BACKLOG;
+          }
      }
    if (sd->preedit_str)
      {
@@ -4907,23 +6086,33 @@ _smart_apply(Evas_Object *obj)
                }
              evas_object_textgrid_update_add(sd->grid.obj, 0, sd->cursor.y,
                                              sd->grid.w, y - sd->cursor.y + 1);
+             memset(sd->drawn.flags + sd->cursor.y, 0, y - sd->cursor.y + 1);
           }
         preedit_x = x - sd->cursor.x;
         preedit_y = y - sd->cursor.y;
      }
-   termpty_backlog_unlock();
+   sd->drawn.pushed = sd->pty->backlog_pushed;
+   sd->drawn.scroll = sd->scroll;
+   sd->drawn.inv = !!inv;
+   sd->drawn.colors_gen = colors_generation_get();
+   sd->drawn.valid = EINA_TRUE;
+   sd->drawn.screen_dirty = EINA_FALSE;
+   termpty_backlog_unlock(sd->pty);
 
    EINA_LIST_FOREACH_SAFE(sd->pty->block.active, l, ln, blk)
      {
         if (!blk->active)
           {
              blk->was_active = EINA_FALSE;
-             _block_obj_del(blk);
              sd->pty->block.active = eina_list_remove_list
                (sd->pty->block.active, l);
+             _block_cache_add(sd, blk);
           }
+        else
+          _block_geometry_set(sd, blk, ox, oy);
      }
-   if ((sd->scroll != 0) || (sd->pty->termstate.hide_cursor))
+   if ((sd->scroll != 0) || (sd->filter.on) ||
+       (sd->pty->termstate.hide_cursor))
      evas_object_hide(sd->cursor.obj);
    else
      evas_object_show(sd->cursor.obj);
@@ -4932,7 +6121,7 @@ _smart_apply(Evas_Object *obj)
    evas_object_move(sd->cursor.obj,
                     ox + ((sd->cursor.x + preedit_x) * sd->font.chw),
                     oy + ((sd->cursor.y + preedit_y) * sd->font.chh));
-   if (sd->pty->selection.is_active)
+   if ((sd->pty->selection.is_active) && (!sd->filter.on))
      {
         int start_x, start_y, end_x, end_y;
         int size_top, size_bottom;
@@ -5014,6 +6203,8 @@ _smart_apply(Evas_Object *obj)
        ecore_timer_reset(sd->mouseover_delay);
      }
    miniview_redraw(term_miniview_get(sd->term));
+   if (sd->pty->latency)
+     termpty_latency_stage(sd->pty->latency, TERMPTY_LATENCY_APPLY);
 }
 
 static void
@@ -5040,6 +6231,9 @@ _smart_size(Evas_Object *obj, int w, int h, Eina_Bool force)
                                        sd->font.chh * sd->grid.h);
    _sel_set(sd, EINA_FALSE);
    termpty_resize(sd->pty, w, h);
+   /* lines got wrapped again */
+   _filter_reset(sd);
+   _drawn_reset(sd);
 
    _smart_calculate(obj);
    _smart_apply(obj);
@@ -5065,6 +6259,39 @@ _smart_cb_delayed_size(void *data)
    return EINA_FALSE;
 }
 
+/* longest a synchronized update may hold the screen, in seconds */
+#define SYNC_UPDATE_TIMEOUT 0.5
+
+static void
+_smart_sync_end(Termio *sd)
+{
+   if (sd->sync.timer)
+     {
+        ecore_timer_del(sd->sync.timer);
+        sd->sync.timer = NULL;
+     }
+   if (sd->sync.held)
+     DBG("synchronized update held back %lu frames (%lu so far)",
+         sd->sync.held, sd->sync.held_total);
+   sd->sync.held = 0;
+   sd->sync.expired = EINA_FALSE;
+}
+
+static Eina_Bool
+_smart_cb_sync_timeout(void *data)
+{
+   Evas_Object *obj = data;
+   Termio *sd = evas_object_smart_data_get(obj);
+
+   EINA_SAFETY_ON_NULL_RETURN_VAL(sd, ECORE_CALLBACK_CANCEL);
+   sd->sync.timer = NULL;
+   sd->sync.expired = EINA_TRUE;
+   DBG("synchronized update not ended after %.1fs, showing it anyway",
+       SYNC_UPDATE_TIMEOUT);
+   _smart_update_queue(obj, sd);
+   return ECORE_CALLBACK_CANCEL;
+}
+
 static Eina_Bool
 _smart_cb_change(void *data)
 {
@@ -5073,6 +6300,17 @@ _smart_cb_change(void *data)
 
    EINA_SAFETY_ON_NULL_RETURN_VAL(sd, EINA_FALSE);
    sd->anim = NULL;
+   /* half drawn: the frame comes when the update ends, or when the
+    * application took too long to end it */
+   if ((sd->pty->sync_update) && (!sd->sync.expired))
+     {
+        sd->sync.held++;
+        sd->sync.held_total++;
+        if (!sd->sync.timer)
+          sd->sync.timer = ecore_timer_add(SYNC_UPDATE_TIMEOUT,
+                                           _smart_cb_sync_timeout, obj);
+        return EINA_FALSE;
+     }
    _smart_apply(obj);
    evas_object_smart_callback_call(obj, "changed", NULL);
    return EINA_FALSE;
@@ -5081,6 +6319,11 @@ _smart_cb_change(void *data)
 static void
 _smart_update_queue(Evas_Object *obj, Termio *sd)
 {
+   if (sd->hidden)
+     {
+        sd->hidden_changed = EINA_TRUE;
+        return;
+     }
    if (sd->anim) return;
    sd->anim = ecore_animator_add(_smart_cb_change, obj);
 }
@@ -5316,9 +6559,20 @@ _smart_del(Evas_Object *obj)
    if (sd->anim) ecore_animator_del(sd->anim);
    if (sd->delayed_size_timer) ecore_timer_del(sd->delayed_size_timer);
    if (sd->link_do_timer) ecore_timer_del(sd->link_do_timer);
+   if (sd->sync.timer) ecore_timer_del(sd->sync.timer);
    if (sd->mouse_move_job) ecore_job_del(sd->mouse_move_job);
+   if (sd->mouse.motion.anim) ecore_animator_del(sd->mouse.motion.anim);
    if (sd->mouseover_delay) ecore_timer_del(sd->mouseover_delay);
    if (sd->font.name) eina_stringshare_del(sd->font.name);
+   /* the shell is still running: terminology is quitting or the
+    * terminal got closed, keep what was on it */
+   if ((sd->pty) && (sd->config) && (sd->config->snapshot_on_exit) &&
+       (termpty_pid_get(sd->pty) >= 0))
+     termio_snapshot_save(obj, NULL);
+   evas_event_callback_del_full(evas_object_evas_get(obj),
+                                EVAS_CALLBACK_RENDER_POST,
+                                _smart_cb_render_post, obj);
+   _block_cache_trim(sd, 0);
    if (sd->pty) termpty_free(sd->pty);
    if (sd->link.string) free(sd->link.string);
    if (sd->glayer) evas_object_del(sd->glayer);
@@ -5334,6 +6588,17 @@ _smart_del(Evas_Object *obj)
    keyin_compose_seq_reset(&sd->khdl);
    if (sd->sel_str) eina_stringshare_del(sd->sel_str);
    if (sd->preedit_str) eina_stringshare_del(sd->preedit_str);
+   if (sd->search.needle) eina_stringshare_del(sd->search.needle);
+   termio_search_free(sd->search.s);
+   if (sd->filter.needle) eina_stringshare_del(sd->filter.needle);
+   termio_search_free(sd->filter.s);
+   free(sd->filter.rows);
+   free(sd->filter.tail);
+   free(sd->filter.line);
+   free(sd->row_colors);
+   free(sd->drawn.flags);
+   _linkmap_free(sd);
+   _termio_link_matcher_free(sd->link_matcher);
    if (sd->sel_reset_job) ecore_job_del(sd->sel_reset_job);
    EINA_LIST_FREE(sd->cur_chids, chid) eina_stringshare_del(chid);
    sd->sel_str = NULL;
@@ -5428,6 +6693,9 @@ _smart_pty_change(void *data)
 
 // if scroll to bottom on updates
    if (sd->jump_on_change)  sd->scroll = 0;
+   sd->drawn.screen_dirty = EINA_TRUE;
+   if (!sd->pty->sync_update)
+     _smart_sync_end(sd);
    _smart_update_queue(data, sd);
 }
 
@@ -5546,6 +6814,34 @@ _smart_pty_command(void *data)
              termpty_write(ty, buf, strlen(buf));
              return;
           }
+        else if (ty->cur_cmd[1] == 'l')
+          {
+             char *report;
+
+             // ql+ starts tracing keystrokes, ql- stops and forgets,
+             // ql0 forgets and ql writes back what was seen so far
+             if (ty->cur_cmd[2] == '+')
+               {
+                  if (!ty->latency) ty->latency = termpty_latency_new();
+               }
+             else if (ty->cur_cmd[2] == '-')
+               {
+                  termpty_latency_free(ty->latency);
+                  ty->latency = NULL;
+               }
+             else if (ty->cur_cmd[2] == '0')
+               {
+                  if (ty->latency) termpty_latency_reset(ty->latency);
+               }
+             else if (!ty->latency)
+               termpty_write(ty, "\n", 1);
+             else if ((report = termpty_latency_report(ty->latency)))
+               {
+                  termpty_write(ty, report, strlen(report));
+                  free(report);
+               }
+             return;
+          }
         else if (ty->cur_cmd[1] == 'j')
           {
              const char *chid = &(ty->cur_cmd[3]);
@@ -5978,6 +7274,7 @@ termio_add(Evas_Object *parent, Config *config,
         return NULL;
      }
    sd->pty->obj = obj;
+   termpty_save_index_set(sd->pty, config->scrollback_index);
    sd->pty->cb.change.func = _smart_pty_change;
    sd->pty->cb.change.data = obj;
    sd->pty->cb.set_title.func = _smart_pty_title;
@@ -5992,6 +7289,8 @@ termio_add(Evas_Object *parent, Config *config,
    sd->pty->cb.bell.data = obj;
    sd->pty->cb.command.func = _smart_pty_command;
    sd->pty->cb.command.data = obj;
+   evas_event_callback_add(e, EVAS_CALLBACK_RENDER_POST,
+                           _smart_cb_render_post, obj);
    _smart_size(obj, w, h, EINA_FALSE);
    return obj;
 }
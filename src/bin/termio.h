@@ -6,6 +6,8 @@
 #include "col.h"
 #include "termpty.h"
 #include "win.h"
+#include "termiolink.h"
+#include "termioexport.h"
 
 Evas_Object *termio_add(Evas_Object *parent, Config *config, const char *cmd, Eina_Bool login_shell, const char *cd, int w, int h, Term *term);
 void         termio_win_set(Evas_Object *obj, Evas_Object *win);
@@ -18,6 +20,7 @@ void termio_scroll_delta(Evas_Object *obj, int delta, int by_page);
 void termio_scroll_set(Evas_Object *obj, int scroll);
 void termio_scroll(Evas_Object *obj, int direction, int start_y, int end_y);
 void termio_content_change(Evas_Object *obj, Evas_Coord x, Evas_Coord y, int n);
+void termio_visible_set(Evas_Object *obj, Eina_Bool visible);
 
 void         termio_config_update(Evas_Object *obj);
 Config      *termio_config_get(const Evas_Object *obj);
@@ -34,12 +37,23 @@ pid_t        termio_pid_get(const Evas_Object *obj);
 Eina_Bool    termio_cwd_get(const Evas_Object *obj, char *buf, size_t size);
 Evas_Object *termio_textgrid_get(Evas_Object *obj);
 Evas_Object *termio_win_get(Evas_Object *obj);
+Eina_Bool    termio_snapshot_save(Evas_Object *obj, const char *path);
+Eina_Bool    termio_snapshot_restore(Evas_Object *obj, const char *path);
+Eina_Bool    termio_scrollback_save(Evas_Object *obj, const char *path, Termio_Export_Format format);
+Eina_Bool    termio_search(Evas_Object *obj, const char *needle, int flags, int dir);
+Eina_Bool    termio_search_next(Evas_Object *obj, Eina_Bool backward);
+Eina_Bool    termio_search_cancel(Evas_Object *obj);
+void         termio_search_clear(Evas_Object *obj);
+Eina_Bool    termio_filter(Evas_Object *obj, const char *needle, int flags);
+Eina_Bool    termio_filter_toggle(Evas_Object *obj);
+Eina_Bool    termio_filter_active_get(const Evas_Object *obj);
 const char  *termio_title_get(Evas_Object *obj);
 const char  *termio_icon_name_get(Evas_Object *obj);
 void         termio_media_mute_set(Evas_Object *obj, Eina_Bool mute);
 void         termio_media_visualize_set(Evas_Object *obj, Eina_Bool visualize);
 void         termio_config_set(Evas_Object *obj, Config *config);
 Config      *termio_config_get(const Evas_Object *obj);
+const Termio_Link_Matcher *termio_link_matcher_get(Evas_Object *obj);
 
 Termpty *termio_pty_get(Evas_Object *obj);
 Evas_Object * termio_miniview_get(Evas_Object *obj);
@@ -0,0 +1,444 @@
+#include "private.h"
+#include <Elementary.h>
+#include <errno.h>
+#include <unistd.h>
+#include "termpty.h"
+#include "col.h"
+#include "termioexport.h"
+#include "utf8.h"
+
+/* Exporting text
+ *
+ * Output is written to a chunk of TERMIO_EXPORT_CHUNK bytes.  The chunk is
+ * handed to the write callback whenever it is full, so that saving the
+ * whole history to a file never holds more than that.  Ascii codepoints,
+ * by far the most common ones, are copied as they are.  Blanks are held
+ * back until something else comes, so that trailing ones can be dropped
+ * at the end of lines.  ANSI output adds an SGR sequence whenever the
+ * attributes change, HTML output a span with the colors of the textgrid
+ * palette.
+ */
+
+#define TERMIO_EXPORT_CHUNK 65536
+/* enough for the longest SGR sequence */
+#define TERMIO_EXPORT_ROOM 128
+
+struct _Termio_Export
+{
+   Termio_Export_Format format;
+   Termio_Export_Write_Cb cb;
+   void *data;
+   char *buf;
+   size_t len;
+   /* blanks held back */
+   char *blanks;
+   size_t nblanks, blanks_size;
+   /* the row set by termio_export_row_set() */
+   const Termcell *cells;
+   int w;
+   Color_Pair *colors;
+   int colors_size;
+   /* 256 standard then 256 extended colors, as ARGB */
+   const unsigned int *palette;
+   /* attributes of what was written last */
+   unsigned int key;
+   unsigned char rtrim : 1;
+   unsigned char reverse : 1;
+   unsigned char started : 1;
+   unsigned char span : 1; /* an HTML span is open */
+   unsigned char failed : 1;
+};
+
+static void
+_flush(Termio_Export *e)
+{
+   if ((e->len > 0) && (!e->failed))
+     {
+        if (!e->cb(e->data, e->buf, e->len))
+          e->failed = EINA_TRUE;
+     }
+   e->len = 0;
+}
+
+static inline void
+_room(Termio_Export *e, size_t len)
+{
+   if (e->len + len > TERMIO_EXPORT_CHUNK) _flush(e);
+}
+
+static void
+_write(Termio_Export *e, const char *s, size_t len)
+{
+   while (len > 0)
+     {
+        size_t n = TERMIO_EXPORT_CHUNK - e->len;
+
+        if (n > len) n = len;
+        memcpy(e->buf + e->len, s, n);
+        e->len += n;
+        s += n;
+        len -= n;
+        if (e->len == TERMIO_EXPORT_CHUNK) _flush(e);
+     }
+}
+
+static void
+_blanks_add(Termio_Export *e, char c, size_t n)
+{
+   if (e->nblanks + n > e->blanks_size)
+     {
+        size_t size = e->blanks_size ? e->blanks_size : 256;
+        char *tmp;
+
+        while (size < e->nblanks + n) size *= 2;
+        tmp = realloc(e->blanks, size);
+        if (!tmp)
+          {
+             e->failed = EINA_TRUE;
+             return;
+          }
+        e->blanks = tmp;
+        e->blanks_size = size;
+     }
+   memset(e->blanks + e->nblanks, c, n);
+   e->nblanks += n;
+}
+
+static inline void
+_blanks_flush(Termio_Export *e)
+{
+   if (e->nblanks == 0) return;
+   _write(e, e->blanks, e->nblanks);
+   e->nblanks = 0;
+}
+
+static void
+_start(Termio_Export *e)
+{
+   char buf[256];
+   unsigned int fg = 0xffaaaaaa, bg = 0xff222222;
+
+   e->started = EINA_TRUE;
+   if (e->format != TERMIO_EXPORT_HTML) return;
+   /* the default background is what inverted default cells are drawn
+    * with, as colors_row_get() does */
+   if (e->palette)
+     {
+        fg = e->palette[e->reverse ? COL_INVERSE : COL_DEF];
+        bg = e->palette[e->reverse ? COL_INVERSEBG : COL_INVERSE];
+     }
+   snprintf(buf, sizeof(buf),
+            "<!DOCTYPE html>\n"
+            "<html><head><meta charset=\"utf-8\"></head>\n"
+            "<body style=\"background-color:#%06x\">"
+            "<pre style=\"color:#%06x\">",
+            bg & 0xffffff, fg & 0xffffff);
+   _write(e, buf, strlen(buf));
+}
+
+static unsigned int
+_ansi_key(const Termatt *att)
+{
+   return att->fg | (att->bg << 8) |
+      (att->fg256 << 16) | (att->bg256 << 17) |
+      (att->fgintense << 18) | (att->bgintense << 19) |
+      (att->bold << 20) | (att->faint << 21) | (att->underline << 22) |
+      (att->blink << 23) | (att->inverse << 24) | (att->invisible << 25) |
+      (att->strike << 26)
+#if defined(SUPPORT_ITALIC)
+      | (att->italic << 27)
+#endif
+      ;
+}
+
+static int
+_ansi_color(char *buf, size_t size, int col, Eina_Bool ext,
+            Eina_Bool intense, int base)
+{
+   if (ext)
+     return snprintf(buf, size, ";%i;5;%i", base + 8, col);
+   if ((col < COL_BLACK) || (col > COL_WHITE))
+     return 0;
+   return snprintf(buf, size, ";%i",
+                   (intense ? base + 60 : base) + col - COL_BLACK);
+}
+
+static void
+_ansi_set(Termio_Export *e, const Termatt *att)
+{
+   char buf[TERMIO_EXPORT_ROOM];
+   int n;
+
+   n = snprintf(buf, sizeof(buf), "\033[0");
+   if (att->bold) n += snprintf(buf + n, sizeof(buf) - n, ";1");
+   if (att->faint) n += snprintf(buf + n, sizeof(buf) - n, ";2");
+#if defined(SUPPORT_ITALIC)
+   if (att->italic) n += snprintf(buf + n, sizeof(buf) - n, ";3");
+#endif
+   if (att->underline) n += snprintf(buf + n, sizeof(buf) - n, ";4");
+   if (att->blink) n += snprintf(buf + n, sizeof(buf) - n, ";5");
+   if (att->inverse) n += snprintf(buf + n, sizeof(buf) - n, ";7");
+   if (att->invisible) n += snprintf(buf + n, sizeof(buf) - n, ";8");
+   if (att->strike) n += snprintf(buf + n, sizeof(buf) - n, ";9");
+   n += _ansi_color(buf + n, sizeof(buf) - n, att->fg, att->fg256,
+                    att->fgintense, 30);
+   n += _ansi_color(buf + n, sizeof(buf) - n, att->bg, att->bg256,
+                    att->bgintense, 40);
+   n += snprintf(buf + n, sizeof(buf) - n, "m");
+   _write(e, buf, n);
+}
+
+static unsigned int
+_html_key(const Termatt *att, const Color_Pair *col)
+{
+   return col->fg | (col->bg << 8) |
+      (col->fg_ext << 16) | (col->bg_ext << 17) |
+      (att->bold << 18) | (att->underline << 19) | (att->strike << 20) |
+      (att->invisible << 21)
+#if defined(SUPPORT_ITALIC)
+      | (att->italic << 22)
+#endif
+      ;
+}
+
+static void
+_html_set(Termio_Export *e, const Termatt *att, const Color_Pair *col)
+{
+   char buf[TERMIO_EXPORT_ROOM * 2];
+   unsigned int fg, bg;
+   int n = 0;
+
+   if (e->span) _write(e, "</span>", 7);
+   e->span = EINA_FALSE;
+   if (!e->palette) return;
+
+   fg = e->palette[col->fg + (col->fg_ext ? 256 : 0)];
+   bg = e->palette[col->bg + (col->bg_ext ? 256 : 0)];
+   if ((col->fg_ext) || (col->fg != 0))
+     n += snprintf(buf + n, sizeof(buf) - n, "color:#%06x;", fg & 0xffffff);
+   if ((bg >> 24) != 0)
+     n += snprintf(buf + n, sizeof(buf) - n, "background-color:#%06x;",
+                   bg & 0xffffff);
+   if (att->bold)
+     n += snprintf(buf + n, sizeof(buf) - n, "font-weight:bold;");
+#if defined(SUPPORT_ITALIC)
+   if (att->italic)
+     n += snprintf(buf + n, sizeof(buf) - n, "font-style:italic;");
+#endif
+   if ((att->underline) || (att->strike))
+     n += snprintf(buf + n, sizeof(buf) - n, "text-decoration:%s%s;",
+                   att->underline ? "underline " : "",
+                   att->strike ? "line-through" : "");
+   if (att->invisible)
+     n += snprintf(buf + n, sizeof(buf) - n, "visibility:hidden;");
+   if (n == 0) return;
+   _write(e, "<span style=\"", 13);
+   _write(e, buf, n);
+   _write(e, "\">", 2);
+   e->span = EINA_TRUE;
+}
+
+/* writes what changes the attributes to the ones of cell x */
+static void
+_attrs_set(Termio_Export *e, int x)
+{
+   const Termatt *att = &(e->cells[x].att);
+   unsigned int key;
+
+   if (e->format == TERMIO_EXPORT_ANSI)
+     key = _ansi_key(att);
+   else
+     key = _html_key(att, &(e->colors[x]));
+   if (key == e->key) return;
+   /* the blanks so far go with the previous attributes */
+   _blanks_flush(e);
+   e->key = key;
+   if (e->format == TERMIO_EXPORT_ANSI)
+     _ansi_set(e, att);
+   else
+     _html_set(e, att, &(e->colors[x]));
+}
+
+Termio_Export *
+termio_export_new(Termio_Export_Format format, Eina_Bool rtrim,
+                  Termio_Export_Write_Cb cb, void *data)
+{
+   Termio_Export *e;
+
+   EINA_SAFETY_ON_NULL_RETURN_VAL(cb, NULL);
+   e = calloc(1, sizeof(Termio_Export));
+   if (!e) return NULL;
+   e->buf = malloc(TERMIO_EXPORT_CHUNK);
+   if (!e->buf)
+     {
+        free(e);
+        return NULL;
+     }
+   e->format = format;
+   e->rtrim = !!rtrim;
+   e->cb = cb;
+   e->data = data;
+   /* the default attributes, that need no SGR sequence nor span */
+   e->key = (format == TERMIO_EXPORT_HTML) ? (COL_INVIS << 8) : 0;
+   return e;
+}
+
+/* colors are needed by HTML output, as miniview_colors_get() gets them */
+void
+termio_export_palette_set(Termio_Export *e, const unsigned int *colors,
+                          Eina_Bool reverse)
+{
+   e->palette = colors;
+   e->reverse = !!reverse;
+}
+
+void
+termio_export_row_set(Termio_Export *e, const Termcell *cells, int w)
+{
+   if (!e->started) _start(e);
+   e->cells = cells;
+   e->w = w;
+   if (e->format != TERMIO_EXPORT_HTML) return;
+   if (e->colors_size < w)
+     {
+        Color_Pair *tmp = realloc(e->colors, w * sizeof(Color_Pair));
+
+        if (!tmp)
+          {
+             e->failed = EINA_TRUE;
+             e->w = 0;
+             return;
+          }
+        e->colors = tmp;
+        e->colors_size = w;
+     }
+   colors_row_get(cells, w, e->reverse, e->colors);
+}
+
+void
+termio_export_cell(Termio_Export *e, int x)
+{
+   Eina_Unicode g;
+
+   if ((x < 0) || (x >= e->w)) return;
+   g = e->cells[x].codepoint;
+   if (e->format != TERMIO_EXPORT_TEXT) _attrs_set(e, x);
+   if (g == ' ')
+     {
+        _blanks_add(e, ' ', 1);
+        return;
+     }
+   _blanks_flush(e);
+   _room(e, 8);
+   if ((g < 0x80) &&
+       ((e->format != TERMIO_EXPORT_HTML) ||
+        ((g != '<') && (g != '>') && (g != '&'))))
+     e->buf[e->len++] = g;
+   else if (g == '<')
+     _write(e, "&lt;", 4);
+   else if (g == '>')
+     _write(e, "&gt;", 4);
+   else if (g == '&')
+     _write(e, "&amp;", 5);
+   else
+     {
+        int n = codepoint_to_utf8(g, e->buf + e->len);
+
+        if (n > 0) e->len += n;
+     }
+}
+
+void
+termio_export_spaces(Termio_Export *e, int n)
+{
+   if (n > 0) _blanks_add(e, ' ', n);
+}
+
+void
+termio_export_tab(Termio_Export *e)
+{
+   _blanks_add(e, '\t', 1);
+}
+
+void
+termio_export_newline(Termio_Export *e)
+{
+   if (e->rtrim)
+     e->nblanks = 0;
+   else
+     _blanks_flush(e);
+   _room(e, 1);
+   e->buf[e->len++] = '\n';
+}
+
+/* flushes everything and frees e, returns whether all was written */
+Eina_Bool
+termio_export_end(Termio_Export *e)
+{
+   Eina_Bool ok;
+
+   if (!e->started) _start(e);
+   if (e->rtrim)
+     e->nblanks = 0;
+   else
+     _blanks_flush(e);
+   if ((e->format == TERMIO_EXPORT_ANSI) && (e->key != 0))
+     _write(e, "\033[0m", 4);
+   else if (e->format == TERMIO_EXPORT_HTML)
+     {
+        const char *end = "</pre></body></html>\n";
+
+        if (e->span) _write(e, "</span>", 7);
+        _write(e, end, strlen(end));
+     }
+   _flush(e);
+   ok = !e->failed;
+   free(e->colors);
+   free(e->blanks);
+   free(e->buf);
+   free(e);
+   return ok;
+}
+
+Eina_Bool
+termio_export_fd_write(void *data, const char *buf, size_t len)
+{
+   int fd = *(int *)data;
+
+   while (len > 0)
+     {
+        ssize_t n = write(fd, buf, len);
+
+        if (n < 0)
+          {
+             if (errno == EINTR) continue;
+             ERR("could not write: %s", strerror(errno));
+             return EINA_FALSE;
+          }
+        buf += n;
+        len -= n;
+     }
+   return EINA_TRUE;
+}
+
+Eina_Bool
+termio_export_string_write(void *data, const char *buf, size_t len)
+{
+   Termio_Export_String *s = data;
+
+   if (s->len + len + 1 > s->size)
+     {
+        size_t size = s->size ? s->size : TERMIO_EXPORT_CHUNK;
+        char *tmp;
+
+        while (size < s->len + len + 1) size *= 2;
+        tmp = realloc(s->buf, size);
+        if (!tmp) return EINA_FALSE;
+        s->buf = tmp;
+        s->size = size;
+     }
+   memcpy(s->buf + s->len, buf, len);
+   s->len += len;
+   s->buf[s->len] = '\0';
+   return EINA_TRUE;
+}
@@ -0,0 +1,39 @@
+#ifndef _TERMIO_EXPORT_H__
+#define _TERMIO_EXPORT_H__ 1
+
+#include "termpty.h"
+
+typedef struct _Termio_Export Termio_Export;
+typedef struct _Termio_Export_String Termio_Export_String;
+
+typedef enum _Termio_Export_Format
+{
+   TERMIO_EXPORT_TEXT,
+   TERMIO_EXPORT_ANSI,
+   TERMIO_EXPORT_HTML
+} Termio_Export_Format;
+
+/* gets the output in chunks, returns EINA_FALSE to give up */
+typedef Eina_Bool (*Termio_Export_Write_Cb)(void *data, const char *buf, size_t len);
+
+Termio_Export *termio_export_new(Termio_Export_Format format, Eina_Bool rtrim, Termio_Export_Write_Cb cb, void *data);
+void           termio_export_palette_set(Termio_Export *e, const unsigned int *colors, Eina_Bool reverse);
+void           termio_export_row_set(Termio_Export *e, const Termcell *cells, int w);
+void           termio_export_cell(Termio_Export *e, int x);
+void           termio_export_spaces(Termio_Export *e, int n);
+void           termio_export_tab(Termio_Export *e);
+void           termio_export_newline(Termio_Export *e);
+Eina_Bool      termio_export_end(Termio_Export *e);
+
+/* write callbacks, data being a pointer to a file descriptor or a
+ * Termio_Export_String, whose buf is to be freed */
+struct _Termio_Export_String
+{
+   char *buf;
+   size_t len, size;
+};
+
+Eina_Bool      termio_export_fd_write(void *data, const char *buf, size_t len);
+Eina_Bool      termio_export_string_write(void *data, const char *buf, size_t len);
+
+#endif
@@ -1,41 +1,10 @@
 #include "private.h"
 #include <Elementary.h>
+#include <regex.h>
 #include "termio.h"
+#include "termiolink.h"
 #include "utils.h"
-
-static Eina_Bool
-coord_back(int *x, int *y, int w, int h EINA_UNUSED)
-{
-   (*x)--;
-   if ((*x) < 0)
-     {
-        if ((*y) <= 0)
-          {
-             (*x)++;
-             return EINA_FALSE;
-          }
-        (*x) = w - 1;
-        (*y)--;
-     }
-   return EINA_TRUE;
-}
-
-static Eina_Bool
-coord_forward(int *x, int *y, int w, int h)
-{
-   (*x)++;
-   if ((*x) >= w)
-     {
-        if ((*y) >= (h - 1))
-          {
-             (*x)--;
-             return EINA_FALSE;
-          }
-        (*x) = 0;
-        (*y)++;
-     }
-   return EINA_TRUE;
-}
+#include "utf8.h"
 
 static char *
 _cwd_path_get(const Evas_Object *obj, const char *relpath)
@@ -94,144 +63,567 @@ _is_file(const char *str)
      }
 }
 
-char *
-_termio_link_find(Evas_Object *obj, int cx, int cy,
-                  int *x1r, int *y1r, int *x2r, int *y2r)
+/* Links are looked for in the logical line under the mouse, as far as it
+ * is in view: its rows are read once into codepoints, blank cells being
+ * spaces and the second half of double width characters being 0.  From
+ * the cell under the mouse, the scan goes back to the start of a protocol
+ * or to a delimiter, then forward to the matching delimiter or to a space
+ * that is not escaped.  Only the text found is converted to UTF-8. */
+
+typedef struct _Link_Line Link_Line;
+
+struct _Link_Line
 {
-   char *s;
-   char endmatch = 0;
-   int x1, x2, y1, y2, w = 0, h = 0, sc;
-   size_t len = 0, prev_len = 0;
-   Eina_Bool goback = EINA_TRUE, goforward = EINA_FALSE, escaped = EINA_FALSE;
+   Eina_Unicode *cp;
+   int n, w, top;
+   /* the line goes on past the view, before it or after it */
+   Eina_Bool cut_top, cut;
+};
 
-   x1 = x2 = cx;
-   y1 = y2 = cy;
-   termio_size_get(obj, &w, &h);
-   if ((w <= 0) || (h <= 0)) return NULL;
-   sc = termio_scroll_get(obj);
+static char
+_closing_get(Eina_Unicode g)
+{
+   switch (g)
+     {
+      case '"': return '"';
+      case '\'': return '\'';
+      case '`': return '`';
+      case '<': return '>';
+      case '[': return ']';
+      case '{': return '}';
+      case '(': return ')';
+      default: return 0;
+     }
+}
+
+static inline Eina_Bool
+_is_space(Eina_Unicode g)
+{
+   return (g < 0x80) && (isspace((int)g));
+}
+
+/* whether pty row y goes on on the next one */
+static Eina_Bool
+_row_continues(Termpty *ty, int y, const Termcell *cells, ssize_t w)
+{
+   int back_y = termpty_backlog_row_get(ty, y);
+
+   /* backlog rows may have been cut at another width */
+   if ((back_y > 0) && (termpty_backlog_row_get(ty, y + 1) == back_y))
+     return EINA_TRUE;
+   return ((cells) && (w == ty->w) && (cells[w - 1].att.autowrapped));
+}
+
+static Eina_Bool
+_line_get(Termpty *ty, int cy, int sc, int w, int h, Link_Line *line)
+{
+   int top = cy, bottom = cy, y, i = 0;
+
+   line->cut_top = EINA_FALSE;
    for (;;)
      {
-        prev_len = len;
-        s = termio_selection_get(obj, x1, y1 - sc, x2, y2 - sc, &len, EINA_FALSE);
-        if (!s) break;
-        if (goback)
+        ssize_t rw = 0;
+        Termcell *cells = termpty_cellrow_get(ty, top - 1 - sc, &rw);
+
+        if (!_row_continues(ty, top - 1 - sc, cells, rw)) break;
+        if (top <= 0)
           {
-             if (link_is_protocol(s))
-               {
-                  goback = EINA_FALSE;
-                  goforward = EINA_TRUE;
+             line->cut_top = EINA_TRUE;
+             break;
+          }
+        top--;
+     }
+   line->cut = EINA_FALSE;
+   for (;;)
+     {
+        ssize_t rw = 0;
+        Termcell *cells = termpty_cellrow_get(ty, bottom - sc, &rw);
 
-                  /* Check if the previous char is a delimiter */
-                  coord_back(&x1, &y1, w, h);
-                  free(s);
-                  s = termio_selection_get(obj, x1, y1 - sc, x2, y2 - sc,
-                                           &len, EINA_FALSE);
-                  if (!s) break;
-                  switch (s[0])
-                    {
-                     case '"': endmatch = '"'; break;
-                     case '\'': endmatch = '\''; break;
-                     case '`': endmatch = '`'; break;
-                     case '<': endmatch = '>'; break;
-                     case '[': endmatch = ']'; break;
-                     case '{': endmatch = '}'; break;
-                     case '(': endmatch = ')'; break;
-                    }
-                  if (!(x1 == 0 && y1 == 0))
-                    {
-                       coord_forward(&x1, &y1, w, h);
-
-                       free(s);
-                       prev_len = len;
-                       s = termio_selection_get(obj, x1, y1 - sc, x2, y2 - sc,
-                                                &len, EINA_FALSE);
-                       if (!s) break;
-                    }
-               }
-             else
-               {
-                  switch (s[0])
-                    {
-                     case '"': endmatch = '"'; break;
-                     case '\'': endmatch = '\''; break;
-                     case '`': endmatch = '`'; break;
-                     case '<': endmatch = '>'; break;
-                     case '[': endmatch = ']'; break;
-                     case '{': endmatch = '}'; break;
-                     case '(': endmatch = ')'; break;
-                    }
-                  if ((endmatch) || (isspace(s[0])))
-                    {
-                       goback = EINA_FALSE;
-                       coord_forward(&x1, &y1, w, h);
-                       goforward = EINA_TRUE;
-                       free(s);
-                       s = termio_selection_get(obj, x1, y1 - sc, x2, y2 - sc,
-                                                &len, EINA_FALSE);
-                       if (!s) break;
-                    }
-               }
+        if (!_row_continues(ty, bottom - sc, cells, rw)) break;
+        if (bottom >= h - 1)
+          {
+             line->cut = EINA_TRUE;
+             break;
           }
-        if ((goforward) && (len >= 1))
+        bottom++;
+     }
+   line->w = w;
+   line->top = top;
+   line->n = (bottom - top + 1) * w;
+   line->cp = malloc(line->n * sizeof(Eina_Unicode));
+   if (!line->cp) return EINA_FALSE;
+   for (y = top; y <= bottom; y++)
+     {
+        ssize_t rw = 0;
+        Termcell *cells = termpty_cellrow_get(ty, y - sc, &rw);
+        int x;
+
+        if ((!cells) || (rw < 0)) rw = 0;
+        if (rw > w) rw = w;
+        for (x = 0; x < w; x++, i++)
           {
-             char end = s[len - 1];
-             if (len - prev_len == 2 && len >= 2)
-               end = s[len - 2];
+             if ((x >= rw) || (cells[x].att.newline) || (cells[x].att.tab))
+               line->cp[i] = ' ';
+#if defined(SUPPORT_DBLWIDTH)
+             else if ((cells[x].codepoint == 0) && (cells[x].att.dblwidth))
+               line->cp[i] = 0;
+#endif
+             else if (cells[x].codepoint == 0)
+               line->cp[i] = ' ';
+             else
+               line->cp[i] = cells[x].codepoint;
+          }
+     }
+   return EINA_TRUE;
+}
 
-             if ((end == endmatch) ||
-                 ((!escaped) && (isspace(end))))
-               {
-                  goforward = EINA_FALSE;
-                  coord_back(&x2, &y2, w, h);
-                  endmatch = 0;
-               }
-             escaped = (end == '\\');
+static Eina_Bool
+_protocol_at(const Link_Line *line, int i)
+{
+   char buf[16];
+   int n = 0;
+
+   /* protocols are ascii and short */
+   while ((i < line->n) && (n < (int)sizeof(buf) - 1))
+     {
+        Eina_Unicode g = line->cp[i++];
+
+        if ((g == 0) || (g >= 0x80)) break;
+        buf[n++] = g;
+     }
+   buf[n] = '\0';
+   return link_is_protocol(buf);
+}
+
+static char *
+_line_utf8_get(const Link_Line *line, int start, int end, size_t *lenp)
+{
+   char *s, *p;
+   int i;
+
+   s = malloc((end - start + 1) * 6 + 1);
+   if (!s) return NULL;
+   p = s;
+   for (i = start; i <= end; i++)
+     {
+        int len;
+
+        if (line->cp[i] == 0) continue;
+        len = codepoint_to_utf8(line->cp[i], p);
+        if (len > 0) p += len;
+     }
+   *p = '\0';
+   *lenp = p - s;
+   return s;
+}
+
+/* The patterns of Config links are compiled once into a single extended
+ * regex, each one in a group of its own so that the one matching is known
+ * from the groups set.  A copy without subexpressions tells quickly whether
+ * a line holds any of them at all, without keeping track of groups */
+
+struct _Termio_Link_Matcher
+{
+   regex_t any;
+   regex_t all;
+   int n;
+   size_t nmatch;
+   /* for every pattern, its group in all and its url */
+   int *groups;
+   const char **urls;
+};
+
+typedef struct _Link_Match Link_Match;
+
+struct _Link_Match
+{
+   int start, end; /* cells of the line, end included */
+   int pattern;
+};
+
+void
+_termio_link_matcher_free(Termio_Link_Matcher *m)
+{
+   int i;
+
+   if (!m) return;
+   regfree(&m->any);
+   regfree(&m->all);
+   for (i = 0; i < m->n; i++)
+     eina_stringshare_del(m->urls[i]);
+   free(m->urls);
+   free(m->groups);
+   free(m);
+}
+
+Termio_Link_Matcher *
+_termio_link_matcher_new(const Eina_List *links)
+{
+   Termio_Link_Matcher *m;
+   Eina_Strbuf *buf;
+   const Config_Link *link;
+   const Eina_List *l;
+   int count, n = 0, group = 1;
+
+   count = eina_list_count(links);
+   if (count == 0) return NULL;
+   m = calloc(1, sizeof(Termio_Link_Matcher));
+   if (!m) return NULL;
+   m->groups = calloc(count, sizeof(int));
+   m->urls = calloc(count, sizeof(const char *));
+   buf = eina_strbuf_new();
+   if ((!m->groups) || (!m->urls) || (!buf)) goto fail;
+
+   EINA_LIST_FOREACH(links, l, link)
+     {
+        regex_t re;
+
+        if ((!link->pattern) || (!link->pattern[0])) continue;
+        if (regcomp(&re, link->pattern, REG_EXTENDED) != 0)
+          {
+             WRN("invalid link pattern: %s", link->pattern);
+             continue;
           }
-        if ((goback) && (!coord_back(&x1, &y1, w, h)))
+        if (n > 0) eina_strbuf_append_char(buf, '|');
+        eina_strbuf_append_printf(buf, "(%s)", link->pattern);
+        m->groups[n] = group;
+        if ((link->url) && (link->url[0]))
+          m->urls[n] = eina_stringshare_ref(link->url);
+        group += 1 + re.re_nsub;
+        regfree(&re);
+        n++;
+     }
+   if (n == 0) goto fail;
+   if (regcomp(&m->all, eina_strbuf_string_get(buf), REG_EXTENDED) != 0)
+     goto fail;
+   if (regcomp(&m->any, eina_strbuf_string_get(buf),
+               REG_EXTENDED | REG_NOSUB) != 0)
+     {
+        regfree(&m->all);
+        goto fail;
+     }
+   m->n = n;
+   m->nmatch = group;
+   eina_strbuf_free(buf);
+   return m;
+
+fail:
+   if (buf) eina_strbuf_free(buf);
+   for (; n > 0; n--)
+     eina_stringshare_del(m->urls[n - 1]);
+   free(m->urls);
+   free(m->groups);
+   free(m);
+   return NULL;
+}
+
+/* the matches of the patterns in line, from left to right */
+static Link_Match *
+_matches_get(const Termio_Link_Matcher *m, const Link_Line *line,
+             int *countr)
+{
+   Link_Match *matches = NULL;
+   regmatch_t *rm = NULL;
+   char *s, *p;
+   int *cells, i, count = 0, size = 0, eflags = 0;
+   size_t off = 0, len;
+
+   *countr = 0;
+   if (!m) return NULL;
+   s = malloc(line->n * 6 + 1);
+   cells = malloc((line->n * 6 + 1) * sizeof(int));
+   if ((!s) || (!cells)) goto end;
+   /* which cell every byte comes from */
+   for (p = s, i = 0; i < line->n; i++)
+     {
+        int n, k;
+
+        if (line->cp[i] == 0) continue;
+        n = codepoint_to_utf8(line->cp[i], p);
+        for (k = 0; k < n; k++) cells[(p - s) + k] = i;
+        if (n > 0) p += n;
+     }
+   *p = '\0';
+   len = p - s;
+   if (regexec(&m->any, s, 0, NULL, 0) != 0) goto end;
+
+   rm = malloc(m->nmatch * sizeof(regmatch_t));
+   if (!rm) goto end;
+   while ((off < len) &&
+          (regexec(&m->all, s + off, m->nmatch, rm, eflags) == 0))
+     {
+        Link_Match *lm;
+        int k;
+
+        eflags = REG_NOTBOL;
+        if (rm[0].rm_eo <= rm[0].rm_so)
           {
-             goback = EINA_FALSE;
-             goforward = EINA_TRUE;
+             /* on to the next character */
+             off += rm[0].rm_so + 1;
+             while ((off < len) && ((s[off] & 0xc0) == 0x80)) off++;
+             continue;
           }
-        if ((goforward) && (!coord_forward(&x2, &y2, w, h)))
+        for (k = 0; k < m->n - 1; k++)
+          if (rm[m->groups[k]].rm_so != -1) break;
+        if (count == size)
           {
-             goforward = EINA_FALSE;
+             Link_Match *tmp;
+
+             size = size ? size * 2 : 4;
+             tmp = realloc(matches, size * sizeof(Link_Match));
+             if (!tmp) break;
+             matches = tmp;
           }
-        if ((!goback) && (!goforward))
+        lm = &matches[count++];
+        lm->start = cells[off + rm[0].rm_so];
+        lm->end = cells[off + rm[0].rm_eo - 1];
+        /* with the right half of a double width character */
+        while ((lm->end + 1 < line->n) && (line->cp[lm->end + 1] == 0))
+          lm->end++;
+        lm->pattern = k;
+        off += rm[0].rm_eo;
+     }
+
+end:
+   free(rm);
+   free(cells);
+   free(s);
+   *countr = count;
+   return matches;
+}
+
+/* what a match links to, or NULL if it is nothing a click can open */
+static char *
+_match_link_get(const Termio_Link_Matcher *m, const Link_Line *line,
+                const Link_Match *lm)
+{
+   Eina_Strbuf *buf;
+   char *s;
+   size_t len = 0;
+
+   s = _line_utf8_get(line, lm->start, lm->end, &len);
+   if (!s) return NULL;
+   if (m->urls[lm->pattern])
+     {
+        buf = eina_strbuf_new();
+        if (!buf)
           {
              free(s);
-             s = termio_selection_get(obj, x1, y1 - sc, x2, y2 - sc, &len,
-                                      EINA_FALSE);
-             break;
+             return NULL;
           }
+        eina_strbuf_append(buf, m->urls[lm->pattern]);
+        eina_strbuf_replace_all(buf, "%s", s);
+        free(s);
+        s = eina_strbuf_string_steal(buf);
+        eina_strbuf_free(buf);
+        if (!s) return NULL;
+     }
+   if ((!_is_file(s)) && (!link_is_email(s)) && (!link_is_url(s)))
+     {
         free(s);
-        s = NULL;
+        return NULL;
+     }
+   return s;
+}
+
+/* the link through cell p of line, not starting before min, as it is
+ * written: relative paths are not made absolute.  Without a link, endr
+ * still gets the last cell looked at */
+static char *
+_link_at(const Link_Line *line, int p, int min, int *startr, int *endr)
+{
+   char *s;
+   char endmatch = 0;
+   int start, i;
+   size_t len = 0;
+   Eina_Bool escaped = EINA_FALSE, ended = EINA_FALSE;
+
+   *endr = p;
+   /* on the right half of a double width character */
+   while ((p > min) && (line->cp[p] == 0)) p--;
+   if ((_is_space(line->cp[p])) || (_closing_get(line->cp[p])))
+     return NULL;
+
+   for (start = p; start > min; start--)
+     {
+        if (_protocol_at(line, start))
+          {
+             endmatch = _closing_get(line->cp[start - 1]);
+             break;
+          }
+        endmatch = _closing_get(line->cp[start - 1]);
+        if ((endmatch) || (_is_space(line->cp[start - 1])))
+          break;
      }
-   if (s)
+
+   for (i = p; i < line->n; i++)
      {
-        if ((len > 1) && (!endmatch))
+        Eina_Unicode g = line->cp[i];
+
+        if (((endmatch) && (g == (Eina_Unicode)endmatch)) ||
+            ((!escaped) && (_is_space(g))))
           {
-             Eina_Bool is_file = _is_file(s);
+             ended = EINA_TRUE;
+             break;
+          }
+        escaped = (g == '\\');
+     }
+   /* the end of a line that is not cut by the view ends links too */
+   if ((!ended) && (!line->cut)) ended = EINA_TRUE;
+   *endr = i - 1;
+   if ((endmatch) && (!ended)) return NULL;
+
+   s = _line_utf8_get(line, start, i - 1, &len);
+   if (!s) return NULL;
+   if ((len <= 1) ||
+       ((!_is_file(s)) && (!link_is_email(s)) && (!link_is_url(s))))
+     {
+        free(s);
+        return NULL;
+     }
+   *startr = start;
+   return s;
+}
+
+/* the last cell from p on, up to end, through which _link_at() finds the
+ * same as through p: another link can only start after a space or an
+ * opening character, or at a protocol */
+static int
+_link_skip(const Link_Line *line, int p, int end)
+{
+   while ((p < end) && (!_is_space(line->cp[p])) &&
+          (!_closing_get(line->cp[p])) && (!_protocol_at(line, p + 1)))
+     p++;
+   return p;
+}
 
-             if (is_file ||
-                 link_is_email(s) ||
-                 link_is_url(s))
+/* what a link found on screen points to */
+char *
+_termio_link_resolve(const Evas_Object *obj, const char *link)
+{
+   if ((_is_file(link)) && (link[0] != '/'))
+     return _local_path_get(obj, link);
+   return strdup(link);
+}
+
+char *
+_termio_link_find(Evas_Object *obj, int cx, int cy,
+                  int *x1r, int *y1r, int *x2r, int *y2r)
+{
+   Termpty *ty = termio_pty_get(obj);
+   Link_Line line;
+   Link_Match *matches;
+   char *s = NULL, *ret;
+   int w = 0, h = 0, sc, p, i, count = 0, start = 0, end = 0;
+
+   termio_size_get(obj, &w, &h);
+   if ((w <= 0) || (h <= 0) || (!ty)) return NULL;
+   if ((cx < 0) || (cx >= w) || (cy < 0) || (cy >= h)) return NULL;
+   sc = termio_scroll_get(obj);
+
+   termpty_backlog_lock(ty);
+   if (!_line_get(ty, cy, sc, w, h, &line))
+     {
+        termpty_backlog_unlock(ty);
+        return NULL;
+     }
+   termpty_backlog_unlock(ty);
+
+   p = (cy - line.top) * w + cx;
+   matches = _matches_get(termio_link_matcher_get(obj), &line, &count);
+   for (i = 0; i < count; i++)
+     {
+        if ((matches[i].start > p) || (p > matches[i].end)) continue;
+        s = _match_link_get(termio_link_matcher_get(obj), &line,
+                            &matches[i]);
+        start = matches[i].start;
+        end = matches[i].end;
+        break;
+     }
+   free(matches);
+   if (i == count)
+     s = _link_at(&line, p, 0, &start, &end);
+   free(line.cp);
+   if (!s) return NULL;
+   if (x1r) *x1r = start % w;
+   if (y1r) *y1r = line.top + (start / w);
+   if (x2r) *x2r = end % w;
+   if (y2r) *y2r = line.top + (end / w);
+   ret = _termio_link_resolve(obj, s);
+   free(s);
+   return ret;
+}
+
+/* calls cb for every link of the logical line through row cy of the
+ * view, from left to right, and tells which rows the line covers and
+ * whether it goes on past the view */
+Eina_Bool
+_termio_links_find(Evas_Object *obj, int cy, int *topr, int *bottomr,
+                   Eina_Bool *cutr, Termio_Link_Cb cb, void *data)
+{
+   Termpty *ty = termio_pty_get(obj);
+   const Termio_Link_Matcher *m = termio_link_matcher_get(obj);
+   Link_Line line;
+   Link_Match *matches;
+   int w = 0, h = 0, sc, p, k = 0, count = 0, min = 0;
+
+   termio_size_get(obj, &w, &h);
+   if ((w <= 0) || (h <= 0) || (!ty) || (cy < 0) || (cy >= h))
+     return EINA_FALSE;
+   sc = termio_scroll_get(obj);
+
+   termpty_backlog_lock(ty);
+   if (!_line_get(ty, cy, sc, w, h, &line))
+     {
+        termpty_backlog_unlock(ty);
+        return EINA_FALSE;
+     }
+   termpty_backlog_unlock(ty);
+
+   /* links of the patterns win over the ones found otherwise */
+   matches = _matches_get(m, &line, &count);
+   for (p = 0; p < line.n; p++)
+     {
+        char *s;
+        int start, end;
+
+        if ((k < count) && (p >= matches[k].start))
+          {
+             start = matches[k].start;
+             end = matches[k].end;
+             k++;
+             s = _match_link_get(m, &line, &matches[k - 1]);
+          }
+        else
+          {
+             if ((line.cp[p] == 0) || (_is_space(line.cp[p]))) continue;
+             s = _link_at(&line, p, min, &start, &end);
+             /* no need to look again at what got scanned */
+             if (!s)
                {
-                  if (x1r) *x1r = x1;
-                  if (y1r) *y1r = y1;
-                  if (x2r) *x2r = x2;
-                  if (y2r) *y2r = y2;
-
-                  if (is_file && (s[0] != '/'))
-                    {
-                       char *ret = _local_path_get(obj, s);
-                       free(s);
-                       return ret;
-                    }
-
-                  return s;
+                  p = _link_skip(&line, p, end);
+                  continue;
+               }
+             if ((k < count) && (end >= matches[k].start))
+               {
+                  free(s);
+                  p = _link_skip(&line, p, matches[k].start - 1);
+                  continue;
                }
           }
-        free(s);
+        if (s)
+          {
+             cb(data, s, start % w, line.top + (start / w),
+                end % w, line.top + (end / w));
+             free(s);
+          }
+        p = end;
+        min = end + 1;
      }
-   return NULL;
+   free(matches);
+   *topr = line.top;
+   *bottomr = line.top + (line.n / w) - 1;
+   *cutr = (line.cut_top) || (line.cut);
+   free(line.cp);
+   return EINA_TRUE;
 }
@@ -1,6 +1,15 @@
 #ifndef _TERMIO_LINK_H__
 #define _TERMIO_LINK_H__ 1
 
+typedef struct _Termio_Link_Matcher Termio_Link_Matcher;
+
+/* link is as written, see _termio_link_resolve() */
+typedef void (*Termio_Link_Cb)(void *data, const char *link, int x1, int y1, int x2, int y2);
+
 char *_termio_link_find(Evas_Object *obj, int cx, int cy, int *x1r, int *y1r, int *x2r, int *y2r);
+Eina_Bool _termio_links_find(Evas_Object *obj, int cy, int *topr, int *bottomr, Eina_Bool *cutr, Termio_Link_Cb cb, void *data);
+char *_termio_link_resolve(const Evas_Object *obj, const char *link);
+Termio_Link_Matcher *_termio_link_matcher_new(const Eina_List *links);
+void _termio_link_matcher_free(Termio_Link_Matcher *m);
 
 #endif
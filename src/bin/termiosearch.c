@@ -0,0 +1,985 @@
+#include "private.h"
+#include <Elementary.h>
+#include <wctype.h>
+#include <regex.h>
+#include "termpty.h"
+#include "termptysave.h"
+#include "termiosearch.h"
+#include "utf8.h"
+
+/* Searching the scrollback
+ *
+ * Plain searches keep the needle as folded codepoints and rows are
+ * scanned cell by cell, only looking further when the first codepoint
+ * matches.  Such a search goes through at most TERMIO_SEARCH_SLICE rows
+ * per main loop iteration so that long histories do not get in the way
+ * of typing.  Matches do not span rows.  When the backlog is indexed,
+ * backlog rows the index rules out are skipped without being unpacked.
+ *
+ * Regex searches copy the text of the screen and the backlog as UTF-8
+ * lines, rows joined by autowrap being one line, and run the regex on
+ * that copy in a thread.  Matches are sent back to the main loop line
+ * by line and kept sorted, so that they can be highlighted and walked
+ * through while the search is still running.
+ */
+
+#define TERMIO_SEARCH_SLICE 1024
+#define TERMIO_SEARCH_SKIPS 16384
+#define TERMIO_SEARCH_MATCHES_MAX 65536
+
+typedef struct _Search_Line  Search_Line;
+typedef struct _Search_Row   Search_Row;
+typedef struct _Search_Job   Search_Job;
+typedef struct _Search_Batch Search_Batch;
+
+/* a row of a line starting elsewhere than cols cells after the previous
+ * one, as the screen row going on with a backlog row cut at another
+ * width */
+struct _Search_Row
+{
+   int cell;
+   int y;
+};
+
+struct _Search_Line
+{
+   int         y;
+   int         len;
+   char       *text;
+   /* cell of each codepoint, only when some are double width */
+   int        *cells;
+   Search_Row *rows;
+   int         nrows;
+};
+
+struct _Search_Job
+{
+   Termio_Search *s;
+   char          *pattern;
+   int            flags;
+   int            cols;
+   Search_Line   *lines;
+   int            nlines;
+   int            first;
+   int            dir;
+   int            shift;
+};
+
+struct _Search_Batch
+{
+   int                 n;
+   Termio_Search_Match m[];
+};
+
+struct _Termio_Search
+{
+   Termpty             *ty;
+   Termio_Search_Cb     cb;
+   const void          *data;
+   Eina_Unicode        *needle;
+   char                *pattern;
+   int                  len;
+   int                  flags;
+   Ecore_Idler         *idler;
+   Ecore_Thread        *thread;
+   Search_Job          *job;
+   int                  x, y, dir;
+   int                  rows_left;
+   Termsave_Query      *query;
+   /* for termio_search_line_match() */
+   regex_t              re;
+   Eina_Strbuf         *line;
+   unsigned char        re_set : 1;
+   /* matches are kept in the coordinates they had when found, shift
+    * being how much the content moved since then.  The plain text
+    * search moves y by it at every slice instead */
+   Termio_Search_Match *matches;
+   int                  nmatches, matches_size;
+   int                  shift;
+   unsigned char        target_found : 1;
+};
+
+/* {{{ Plain text */
+
+static inline Eina_Unicode
+_fold(Eina_Unicode g)
+{
+   if (g < 0x80)
+     return ((g >= 'A') && (g <= 'Z')) ? g + ('a' - 'A') : g;
+   return towlower(g);
+}
+
+static inline Eina_Unicode
+_cell_get(const Termio_Search *s, const Termcell *cell)
+{
+   Eina_Unicode g = cell->codepoint;
+
+   /* empty cells are seen as blanks */
+   if (g == 0) return ' ';
+   if (s->flags & TERMIO_SEARCH_CASE_SENSITIVE) return g;
+   return _fold(g);
+}
+
+/* second half of a double width character */
+static inline Eina_Bool
+_cell_is_filler(const Termcell *cells, int x)
+{
+#if defined(SUPPORT_DBLWIDTH)
+   return ((x > 0) && (cells[x].codepoint == 0) &&
+           (cells[x - 1].att.dblwidth) && (cells[x - 1].codepoint != 0));
+#else
+   (void)cells;
+   (void)x;
+   return EINA_FALSE;
+#endif
+}
+
+static inline Eina_Bool
+_is_word(Eina_Unicode g)
+{
+   if (g < 0x80)
+     return ((g == '_') ||
+             ((g >= '0') && (g <= '9')) ||
+             ((g >= 'a') && (g <= 'z')) ||
+             ((g >= 'A') && (g <= 'Z')));
+   return iswalnum(g);
+}
+
+/* returns where the needle ends when it starts at x, or -1 */
+static int
+_match_at(const Termio_Search *s, const Termcell *cells, int w, int x)
+{
+   int i;
+
+   for (i = 0; i < s->len; i++, x++)
+     {
+        while ((x < w) && (_cell_is_filler(cells, x))) x++;
+        if (x >= w) return -1;
+        if (_cell_get(s, &cells[x]) != s->needle[i]) return -1;
+     }
+   while ((x < w) && (_cell_is_filler(cells, x))) x++;
+   return x;
+}
+
+static int
+_text_row_find(const Termio_Search *s, const Termcell *cells, int w,
+               int from, int *end)
+{
+   Eina_Unicode first;
+   int x, x2;
+
+   if (!cells) return -1;
+   if (from < 0) from = 0;
+   first = s->needle[0];
+   for (x = from; x <= w - s->len; x++)
+     {
+        if (_cell_get(s, &cells[x]) != first) continue;
+        x2 = _match_at(s, cells, w, x);
+        if (x2 < 0) continue;
+        if (s->flags & TERMIO_SEARCH_WHOLE_WORD)
+          {
+             int before = x - 1;
+
+             while ((before > 0) && (_cell_is_filler(cells, before)))
+               before--;
+             if ((before >= 0) && (_is_word(cells[before].codepoint)))
+               continue;
+             if ((x2 < w) && (_is_word(cells[x2].codepoint)))
+               continue;
+          }
+        if (end) *end = x2;
+        return x;
+     }
+   return -1;
+}
+
+/* last match starting at or before x */
+static int
+_text_row_find_back(const Termio_Search *s, const Termcell *cells, int w,
+                    int x, int *end)
+{
+   int found = -1, found_end = 0, x1, x2 = 0;
+
+   x1 = _text_row_find(s, cells, w, 0, &x2);
+   while ((x1 >= 0) && (x1 <= x))
+     {
+        found = x1;
+        found_end = x2;
+        x1 = _text_row_find(s, cells, w, x1 + 1, &x2);
+     }
+   if ((found >= 0) && (end)) *end = found_end;
+   return found;
+}
+
+static void
+_text_done(Termio_Search *s, const Termio_Search_Match *m)
+{
+   s->idler = NULL;
+   termpty_save_index_query_free(s->query);
+   s->query = NULL;
+   s->cb((void *)s->data, m, EINA_TRUE);
+}
+
+static Eina_Bool
+_cb_text_slice(void *data)
+{
+   Termio_Search *s = data;
+   Termpty *ty = s->ty;
+   int n, skips = 0, top, x1 = -1, x2 = 0;
+
+   /* follow the rows that moved since the last slice */
+   s->y += s->shift;
+   s->shift = 0;
+   termpty_backlog_lock(ty);
+   top = -termpty_backlog_length(ty);
+   for (n = 0; n < TERMIO_SEARCH_SLICE; n++)
+     {
+        Termcell *cells;
+        ssize_t w = 0;
+
+        if (s->rows_left-- <= 0)
+          {
+             termpty_backlog_unlock(ty);
+             _text_done(s, NULL);
+             return ECORE_CALLBACK_CANCEL;
+          }
+        if (s->y < top)
+          {
+             s->y = ty->h - 1;
+             s->x = ty->w;
+          }
+        else if (s->y >= ty->h)
+          {
+             s->y = top;
+             s->x = 0;
+          }
+        if ((s->y < 0) && (s->query) &&
+            (!termpty_save_index_row_check(ty, s->query,
+                                           termpty_backlog_row_get(ty, s->y))))
+          {
+             /* cheap enough not to count as much as a row checked */
+             if (++skips < TERMIO_SEARCH_SKIPS) n--;
+             s->y += s->dir;
+             s->x = (s->dir > 0) ? 0 : ty->w;
+             continue;
+          }
+        cells = termpty_cellrow_get(ty, s->y, &w);
+        if (s->dir > 0)
+          x1 = _text_row_find(s, cells, w, s->x, &x2);
+        else
+          x1 = _text_row_find_back(s, cells, w, s->x, &x2);
+        if (x1 >= 0)
+          {
+             Termio_Search_Match m = { x1, s->y, x2, s->y };
+
+             termpty_backlog_unlock(ty);
+             _text_done(s, &m);
+             return ECORE_CALLBACK_CANCEL;
+          }
+        s->y += s->dir;
+        s->x = (s->dir > 0) ? 0 : ty->w;
+     }
+   termpty_backlog_unlock(ty);
+   return ECORE_CALLBACK_RENEW;
+}
+
+/* }}} */
+/* {{{ Regex */
+
+static int
+_match_cmp(const Termio_Search_Match *m1, const Termio_Search_Match *m2)
+{
+   if (m1->y1 != m2->y1) return m1->y1 - m2->y1;
+   return m1->x1 - m2->x1;
+}
+
+/* index of the first match not before (x, y) */
+static int
+_match_lower(const Termio_Search *s, int x, int y)
+{
+   Termio_Search_Match key = { x, y, x, y };
+   int lo = 0, hi = s->nmatches;
+
+   while (lo < hi)
+     {
+        int mid = (lo + hi) / 2;
+
+        if (_match_cmp(&s->matches[mid], &key) < 0) lo = mid + 1;
+        else hi = mid;
+     }
+   return lo;
+}
+
+static void
+_match_notify(Termio_Search *s, const Termio_Search_Match *m, int shift,
+              Eina_Bool done)
+{
+   Termio_Search_Match out;
+
+   if (!m)
+     {
+        s->cb((void *)s->data, NULL, done);
+        return;
+     }
+   out = *m;
+   out.y1 += shift;
+   out.y2 += shift;
+   s->cb((void *)s->data, &out, done);
+}
+
+static void
+_matches_add(Termio_Search *s, const Termio_Search_Match *m)
+{
+   int i;
+
+   if (s->nmatches >= TERMIO_SEARCH_MATCHES_MAX) return;
+   if (s->nmatches == s->matches_size)
+     {
+        Termio_Search_Match *tmp;
+        int size = s->matches_size ? s->matches_size * 2 : 64;
+
+        tmp = realloc(s->matches, size * sizeof(Termio_Search_Match));
+        if (!tmp) return;
+        s->matches = tmp;
+        s->matches_size = size;
+     }
+   i = _match_lower(s, m->x1, m->y1);
+   if ((i < s->nmatches) && (_match_cmp(&s->matches[i], m) == 0)) return;
+   memmove(&s->matches[i + 1], &s->matches[i],
+           (s->nmatches - i) * sizeof(Termio_Search_Match));
+   s->matches[i] = *m;
+   s->nmatches++;
+}
+
+static void
+_line_free(Search_Line *line)
+{
+   free(line->text);
+   free(line->cells);
+   free(line->rows);
+}
+
+static void
+_job_free(Search_Job *job)
+{
+   int i;
+
+   for (i = 0; i < job->nlines; i++)
+     _line_free(&job->lines[i]);
+   free(job->lines);
+   free(job->pattern);
+   free(job);
+}
+
+static Search_Line *
+_job_line_add(Search_Job *job, int y, int *size)
+{
+   Search_Line *line;
+
+   if (job->nlines == *size)
+     {
+        Search_Line *tmp;
+
+        *size = *size ? *size * 2 : 256;
+        tmp = realloc(job->lines, *size * sizeof(Search_Line));
+        if (!tmp) return NULL;
+        job->lines = tmp;
+     }
+   line = &job->lines[job->nlines++];
+   memset(line, 0, sizeof(*line));
+   line->y = y;
+   return line;
+}
+
+/* appends w cells to the line, the first one being cell base of it */
+static Eina_Bool
+_line_append(Search_Line *line, const Termcell *cells, int w, int base,
+             Eina_Strbuf *buf, int *nchars)
+{
+   int x;
+
+   for (x = 0; x < w; x++)
+     {
+        Eina_Unicode g = cells[x].codepoint;
+        char txt[8];
+
+        if (_cell_is_filler(cells, x))
+          {
+             if (!line->cells)
+               {
+                  int i;
+
+                  /* so far, one cell per codepoint */
+                  line->cells = malloc((*nchars + w - x) * sizeof(int));
+                  if (!line->cells) return EINA_FALSE;
+                  for (i = 0; i < *nchars; i++) line->cells[i] = i;
+               }
+             continue;
+          }
+        if ((g == 0) || (g & 0x80000000)) g = ' ';
+        codepoint_to_utf8(g, txt);
+        eina_strbuf_append(buf, txt);
+        if (line->cells)
+          {
+             int *tmp = realloc(line->cells, (*nchars + 1) * sizeof(int));
+
+             if (!tmp) return EINA_FALSE;
+             line->cells = tmp;
+             line->cells[*nchars] = base + x;
+          }
+        (*nchars)++;
+     }
+   return EINA_TRUE;
+}
+
+/* column and row of cell c of the line, rows being cols cells wide */
+static void
+_line_pos_get(const Search_Line *line, int cols, int c, int *x, int *y)
+{
+   int cell = 0, row = line->y, i;
+
+   for (i = line->nrows - 1; i >= 0; i--)
+     if (line->rows[i].cell <= c)
+       {
+          cell = line->rows[i].cell;
+          row = line->rows[i].y;
+          break;
+       }
+   *x = (c - cell) % cols;
+   *y = row + ((c - cell) / cols);
+}
+
+/* records that cell base of the line starts row y */
+static Eina_Bool
+_line_row_add(Search_Line *line, int cols, int base, int y)
+{
+   Search_Row *tmp;
+   int x0, y0;
+
+   _line_pos_get(line, cols, base, &x0, &y0);
+   if ((x0 == 0) && (y0 == y)) return EINA_TRUE;
+   tmp = realloc(line->rows, (line->nrows + 1) * sizeof(Search_Row));
+   if (!tmp) return EINA_FALSE;
+   line->rows = tmp;
+   line->rows[line->nrows].cell = base;
+   line->rows[line->nrows].y = y;
+   line->nrows++;
+   return EINA_TRUE;
+}
+
+static void
+_line_end(Search_Line *line, Eina_Strbuf *buf)
+{
+   line->len = eina_strbuf_length_get(buf);
+   line->text = eina_strbuf_string_steal(buf);
+}
+
+/* takes a copy of the text, to be searched in a thread, and returns the
+ * index of the line holding row y */
+static Eina_Bool
+_job_snapshot(Search_Job *job, Termpty *ty, int y_start)
+{
+   Eina_Strbuf *buf;
+   Search_Line *line = NULL;
+   int size = 0, nchars = 0, base = 0, nback = 0, y, i;
+   Eina_Bool ok = EINA_FALSE;
+
+   buf = eina_strbuf_new();
+   if (!buf) return EINA_FALSE;
+   termpty_backlog_lock(ty);
+   job->cols = ty->w;
+   job->first = -1;
+
+   /* backlog rows, from the oldest one */
+   if (ty->back)
+     {
+        for (nback = 0; nback < (int)ty->backsize; nback++)
+          if (!ty->back[(ty->backpos + ty->backsize - nback)
+                        % ty->backsize].cells)
+            break;
+     }
+   y = -termpty_backlog_length(ty);
+   for (i = nback; i > 0; i--)
+     {
+        Termsave *ts = &ty->back[(ty->backpos + ty->backsize - (i - 1))
+                                 % ty->backsize];
+        Termcell *cells = termpty_save_cells_get(ty, ts);
+
+        if (!cells) continue;
+        line = _job_line_add(job, y, &size);
+        if (!line) goto end;
+        nchars = 0;
+        if (!_line_append(line, cells, ts->w, 0, buf, &nchars)) goto end;
+        y += (ts->w == 0) ? 1 : (ts->w + ty->w - 1) / ty->w;
+        base = ts->w;
+        /* a line going on on the screen */
+        if ((i == 1) && (ts->w > 0) &&
+            (cells[ts->w - 1].att.autowrapped))
+          break;
+        _line_end(line, buf);
+        line = NULL;
+     }
+
+   /* screen rows */
+   for (y = 0; y < ty->h; y++)
+     {
+        Termcell *cells;
+        ssize_t w = 0;
+        Eina_Bool wrapped;
+
+        cells = termpty_cellrow_get(ty, y, &w);
+        if (!cells) break;
+        wrapped = ((w > 0) && (cells[w - 1].att.autowrapped));
+        if (!wrapped) w = termpty_line_length(cells, w);
+        if (!line)
+          {
+             line = _job_line_add(job, y, &size);
+             if (!line) goto end;
+             nchars = 0;
+             base = 0;
+          }
+        /* a backlog row cut at another width does not end where
+         * the screen rows start */
+        else if (!_line_row_add(line, ty->w, base, y)) goto end;
+        if (!_line_append(line, cells, w, base, buf, &nchars)) goto end;
+        base += ty->w;
+        if (!wrapped)
+          {
+             _line_end(line, buf);
+             line = NULL;
+          }
+     }
+   if (line) _line_end(line, buf);
+   line = NULL;
+
+   for (i = 0; i < job->nlines; i++)
+     {
+        if (job->lines[i].y > y_start) break;
+        job->first = i;
+     }
+   if (job->first < 0) job->first = 0;
+   ok = EINA_TRUE;
+end:
+   if (line) _line_end(line, buf);
+   termpty_backlog_unlock(ty);
+   eina_strbuf_free(buf);
+   return ok;
+}
+
+/* cell of the character starting at byte off of the line */
+static int
+_line_cell_get(const Search_Line *line, int off)
+{
+   int i, n = 0;
+
+   for (i = 0; i < off; i++)
+     if ((line->text[i] & 0xc0) != 0x80) n++;
+   return line->cells ? line->cells[n] : n;
+}
+
+static void
+_job_run(void *data, Ecore_Thread *thread)
+{
+   Search_Job *job = data;
+   Search_Batch *batch = NULL;
+   regex_t re;
+   int cflags = REG_EXTENDED, n, size = 0, total = 0, g = 0;
+
+   if (!(job->flags & TERMIO_SEARCH_CASE_SENSITIVE)) cflags |= REG_ICASE;
+   /* the word is the second group, see termio_search_needle_set() */
+   if (job->flags & TERMIO_SEARCH_WHOLE_WORD) g = 2;
+   if (regcomp(&re, job->pattern, cflags) != 0) return;
+
+   for (n = 0; n < job->nlines; n++)
+     {
+        Search_Line *line;
+        regmatch_t rms[3], rm;
+        int off = 0, eflags = 0, i;
+
+        if (ecore_thread_check(thread)) break;
+        i = (job->first + (n * job->dir) + job->nlines) % job->nlines;
+        line = &job->lines[i];
+        if (!line->text) continue;
+        while ((off < line->len) &&
+               (regexec(&re, line->text + off, g + 1, rms, eflags) == 0))
+          {
+             Termio_Search_Match *m;
+             int c1, c2, x, y;
+
+             rm = rms[g];
+             if (rm.rm_eo == rm.rm_so)
+               {
+                  /* empty match, go to next character */
+                  off += rm.rm_so + 1;
+                  while ((off < line->len) &&
+                         ((line->text[off] & 0xc0) == 0x80))
+                    off++;
+                  eflags = REG_NOTBOL;
+                  continue;
+               }
+             if ((!batch) || (batch->n == size))
+               {
+                  Search_Batch *tmp;
+
+                  size = batch ? size * 2 : 16;
+                  tmp = realloc(batch, sizeof(Search_Batch) +
+                                size * sizeof(Termio_Search_Match));
+                  if (!tmp) break;
+                  if (!batch) tmp->n = 0;
+                  batch = tmp;
+               }
+             c1 = _line_cell_get(line, off + rm.rm_so);
+             c2 = _line_cell_get(line, off + rm.rm_eo - 1) + 1;
+             m = &batch->m[batch->n++];
+             _line_pos_get(line, job->cols, c1, &x, &y);
+             m->x1 = x;
+             m->y1 = y;
+             _line_pos_get(line, job->cols, c2 - 1, &x, &y);
+             m->x2 = x + 1;
+             m->y2 = y;
+             off += rm.rm_eo;
+             eflags = REG_NOTBOL;
+             total++;
+          }
+        /* whole lines only, so the closest match can be picked, the
+         * first ones as soon as possible */
+        if ((batch) && ((batch->n >= 64) || (total <= 64)))
+          {
+             ecore_thread_feedback(thread, batch);
+             batch = NULL;
+          }
+        if (total >= TERMIO_SEARCH_MATCHES_MAX) break;
+     }
+   if (batch) ecore_thread_feedback(thread, batch);
+   regfree(&re);
+}
+
+static void
+_job_notify(void *data, Ecore_Thread *thread EINA_UNUSED, void *msg)
+{
+   Search_Job *job = data;
+   Search_Batch *batch = msg;
+   Termio_Search *s = job->s;
+   const Termio_Search_Match *target = NULL;
+   int i;
+
+   if (!s)
+     {
+        free(batch);
+        return;
+     }
+   for (i = 0; i < batch->n; i++)
+     {
+        Termio_Search_Match *m = &batch->m[i];
+        int d;
+
+        m->y1 -= job->shift;
+        m->y2 -= job->shift;
+        _matches_add(s, m);
+        m->y1 += job->shift;
+        m->y2 += job->shift;
+        if (s->target_found) continue;
+        d = (m->y1 != s->y) ? m->y1 - s->y : m->x1 - s->x;
+        if (d * s->dir < 0) continue;
+        /* the closest one in the direction of the search */
+        if ((!target) || (_match_cmp(m, target) * s->dir < 0))
+          target = m;
+     }
+   if (target)
+     s->target_found = EINA_TRUE;
+   _match_notify(s, target, s->shift - job->shift, EINA_FALSE);
+   free(batch);
+}
+
+static void
+_job_end(void *data, Ecore_Thread *thread EINA_UNUSED)
+{
+   Search_Job *job = data;
+   Termio_Search *s = job->s;
+
+   if (s)
+     {
+        const Termio_Search_Match *m = NULL;
+
+        s->thread = NULL;
+        s->job = NULL;
+        /* nothing after the start, wrap around */
+        if ((!s->target_found) && (s->nmatches > 0))
+          m = (s->dir > 0) ? &s->matches[0] : &s->matches[s->nmatches - 1];
+        s->target_found = EINA_TRUE;
+        _match_notify(s, m, s->shift, EINA_TRUE);
+     }
+   _job_free(job);
+}
+
+static void
+_regex_start(Termio_Search *s)
+{
+   Search_Job *job;
+
+   s->nmatches = 0;
+   s->target_found = EINA_FALSE;
+   job = calloc(1, sizeof(Search_Job));
+   if (!job) return;
+   job->s = s;
+   job->flags = s->flags;
+   job->dir = s->dir;
+   job->shift = s->shift;
+   job->pattern = strdup(s->pattern);
+   if ((!job->pattern) || (!_job_snapshot(job, s->ty, s->y)) ||
+       (job->nlines == 0))
+     {
+        _job_free(job);
+        s->cb((void *)s->data, NULL, EINA_TRUE);
+        return;
+     }
+   s->job = job;
+   s->thread = ecore_thread_feedback_run(_job_run, _job_notify,
+                                         _job_end, _job_end,
+                                         job, EINA_FALSE);
+}
+
+/* }}} */
+
+int
+termio_search_row_find(const Termio_Search *s, const Termcell *cells,
+                       int w, int y, int from, int *end)
+{
+   const Termio_Search_Match *m = NULL;
+   int i, x, x2 = 0;
+
+   if ((termio_search_needle_empty(s)) || (from >= w)) return -1;
+   if (!(s->flags & TERMIO_SEARCH_REGEX))
+     return _text_row_find(s, cells, w, from, end);
+   y -= s->shift;
+
+   /* first match ending on row y after from, the one before those
+    * starting on that row may span to it */
+   i = _match_lower(s, 0, y);
+   if ((i > 0) && (s->matches[i - 1].y2 >= y)) i--;
+   for (; i < s->nmatches; i++)
+     {
+        m = &s->matches[i];
+        if (m->y1 > y) return -1;
+        x2 = (m->y2 > y) ? w : m->x2;
+        if (x2 > from) break;
+     }
+   if (i >= s->nmatches) return -1;
+   x = (m->y1 < y) ? 0 : m->x1;
+   if (x < from) x = from;
+   if (end) *end = x2;
+   return x;
+}
+
+/* whether cells, a whole logical line, hold the needle.  Unlike
+ * termio_search_row_find(), this also works for a regex without running
+ * a search */
+Eina_Bool
+termio_search_line_match(Termio_Search *s, const Termcell *cells, int w)
+{
+   int x;
+
+   if ((termio_search_needle_empty(s)) || (!cells)) return EINA_FALSE;
+   if (!(s->flags & TERMIO_SEARCH_REGEX))
+     return _text_row_find(s, cells, w, 0, NULL) >= 0;
+   if (!s->re_set) return EINA_FALSE;
+   if (!s->line) s->line = eina_strbuf_new();
+   if (!s->line) return EINA_FALSE;
+   eina_strbuf_reset(s->line);
+   for (x = 0; x < w; x++)
+     {
+        Eina_Unicode g = cells[x].codepoint;
+        char txt[8];
+
+        if (_cell_is_filler(cells, x)) continue;
+        if ((g == 0) || (g & 0x80000000)) g = ' ';
+        codepoint_to_utf8(g, txt);
+        eina_strbuf_append(s->line, txt);
+     }
+   return regexec(&s->re, eina_strbuf_string_get(s->line), 0, NULL, 0) == 0;
+}
+
+Termio_Search *
+termio_search_new(Termpty *ty, Termio_Search_Cb cb, const void *data)
+{
+   Termio_Search *s;
+
+   EINA_SAFETY_ON_NULL_RETURN_VAL(ty, NULL);
+   EINA_SAFETY_ON_NULL_RETURN_VAL(cb, NULL);
+   s = calloc(1, sizeof(Termio_Search));
+   if (!s) return NULL;
+   s->ty = ty;
+   s->cb = cb;
+   s->data = data;
+   return s;
+}
+
+void
+termio_search_free(Termio_Search *s)
+{
+   if (!s) return;
+   termio_search_stop(s);
+   free(s->needle);
+   free(s->pattern);
+   free(s->matches);
+   if (s->re_set) regfree(&s->re);
+   if (s->line) eina_strbuf_free(s->line);
+   free(s);
+}
+
+Eina_Bool
+termio_search_needle_set(Termio_Search *s, const char *needle, int flags)
+{
+   Eina_Unicode *uni = NULL;
+   char *pattern = NULL;
+   int i, len = 0;
+
+   EINA_SAFETY_ON_NULL_RETURN_VAL(s, EINA_FALSE);
+   termio_search_stop(s);
+   if ((needle) && (needle[0]) && (flags & TERMIO_SEARCH_REGEX))
+     {
+        regex_t re;
+        int cflags = REG_EXTENDED | REG_NOSUB;
+
+        /* \< and \> are GNU extensions, so the characters around the
+         * word are matched too, the word being the second group */
+        if (flags & TERMIO_SEARCH_WHOLE_WORD)
+          {
+             static const char fmt[] =
+                "(^|[^[:alnum:]_])(%s)([^[:alnum:]_]|$)";
+             size_t size = strlen(needle) + sizeof(fmt);
+
+             pattern = malloc(size);
+             if (!pattern) return EINA_FALSE;
+             snprintf(pattern, size, fmt, needle);
+          }
+        else
+          pattern = strdup(needle);
+        if (!pattern) return EINA_FALSE;
+        if (!(flags & TERMIO_SEARCH_CASE_SENSITIVE)) cflags |= REG_ICASE;
+        if (regcomp(&re, pattern, cflags) != 0)
+          {
+             free(pattern);
+             return EINA_FALSE;
+          }
+        if (s->re_set) regfree(&s->re);
+        s->re = re;
+        s->re_set = EINA_TRUE;
+        len = 1;
+     }
+   else if ((needle) && (needle[0]))
+     {
+        uni = eina_unicode_utf8_to_unicode(needle, &len);
+        if (!uni) return EINA_FALSE;
+        if (!(flags & TERMIO_SEARCH_CASE_SENSITIVE))
+          for (i = 0; i < len; i++) uni[i] = _fold(uni[i]);
+     }
+   if ((s->re_set) && (!pattern))
+     {
+        regfree(&s->re);
+        s->re_set = EINA_FALSE;
+     }
+   free(s->needle);
+   free(s->pattern);
+   s->needle = uni;
+   s->pattern = pattern;
+   s->len = len;
+   s->flags = flags;
+   s->nmatches = 0;
+   return EINA_TRUE;
+}
+
+Eina_Bool
+termio_search_needle_empty(const Termio_Search *s)
+{
+   return (!s) || (s->len == 0);
+}
+
+void
+termio_search_start(Termio_Search *s, int x, int y, int dir)
+{
+   EINA_SAFETY_ON_NULL_RETURN(s);
+   termio_search_stop(s);
+   if (s->len == 0) return;
+   s->x = x;
+   s->y = y;
+   s->dir = (dir < 0) ? -1 : 1;
+   if (s->flags & TERMIO_SEARCH_REGEX)
+     {
+        _regex_start(s);
+        return;
+     }
+   /* come back to the starting row once, for what is before x */
+   s->shift = 0;
+   termpty_backlog_lock(s->ty);
+   s->rows_left = termpty_backlog_length(s->ty) + s->ty->h + 1;
+   s->query = termpty_save_index_query(s->ty, s->needle, s->len);
+   termpty_backlog_unlock(s->ty);
+   s->idler = ecore_idler_add(_cb_text_slice, s);
+}
+
+/* goes to the match after cur among the ones found by a regex search */
+Eina_Bool
+termio_search_match_next(Termio_Search *s, const Termio_Search_Match *cur,
+                         int dir)
+{
+   Termio_Search_Match key;
+   int i;
+
+   EINA_SAFETY_ON_NULL_RETURN_VAL(s, EINA_FALSE);
+   if ((!(s->flags & TERMIO_SEARCH_REGEX)) || (s->nmatches == 0))
+     return EINA_FALSE;
+   key = *cur;
+   key.y1 -= s->shift;
+   i = _match_lower(s, key.x1, key.y1);
+   if (dir > 0)
+     {
+        if ((i < s->nmatches) && (_match_cmp(&s->matches[i], &key) == 0))
+          i++;
+        if (i >= s->nmatches) i = 0;
+     }
+   else
+     {
+        i--;
+        if (i < 0) i = s->nmatches - 1;
+     }
+   _match_notify(s, &s->matches[i], s->shift, !s->thread);
+   return EINA_TRUE;
+}
+
+/* the content moved by dir rows from start_y, the rows scrolled out of
+ * the screen going to the backlog when it is from its top.  Matches below
+ * a scrolling region are not told apart and move along. */
+void
+termio_search_shift(Termio_Search *s, int start_y, int dir)
+{
+   if ((!s) || (start_y != 0)) return;
+   s->shift += dir;
+}
+
+void
+termio_search_stop(Termio_Search *s)
+{
+   if (!s) return;
+   if (s->idler)
+     {
+        ecore_idler_del(s->idler);
+        s->idler = NULL;
+     }
+   termpty_save_index_query_free(s->query);
+   s->query = NULL;
+   if (s->thread)
+     {
+        /* the job goes on until the thread notices, without us */
+        s->job->s = NULL;
+        ecore_thread_cancel(s->thread);
+        s->thread = NULL;
+        s->job = NULL;
+     }
+}
+
+Eina_Bool
+termio_search_running(const Termio_Search *s)
+{
+   return (s) && ((s->idler) || (s->thread));
+}
@@ -0,0 +1,41 @@
+#ifndef _TERMIO_SEARCH_H__
+#define _TERMIO_SEARCH_H__ 1
+
+#include "termpty.h"
+
+typedef struct _Termio_Search Termio_Search;
+typedef struct _Termio_Search_Match Termio_Search_Match;
+
+typedef enum _Termio_Search_Flags
+{
+   TERMIO_SEARCH_CASE_SENSITIVE = (1 << 0),
+   TERMIO_SEARCH_WHOLE_WORD     = (1 << 1),
+   TERMIO_SEARCH_REGEX          = (1 << 2)
+} Termio_Search_Flags;
+
+/* cells from x1 on row y1 to x2 (excluded) on row y2, in
+ * termpty_cellrow_get() coordinates */
+struct _Termio_Search_Match
+{
+   int x1, y1;
+   int x2, y2;
+};
+
+/* m is the match to go to, if any.  done is set once the search is over,
+ * a regex search may call it before with more matches found */
+typedef void (*Termio_Search_Cb)(void *data, const Termio_Search_Match *m,
+                                 Eina_Bool done);
+
+Termio_Search *termio_search_new(Termpty *ty, Termio_Search_Cb cb, const void *data);
+void           termio_search_free(Termio_Search *s);
+Eina_Bool      termio_search_needle_set(Termio_Search *s, const char *needle, int flags);
+Eina_Bool      termio_search_needle_empty(const Termio_Search *s);
+int            termio_search_row_find(const Termio_Search *s, const Termcell *cells, int w, int y, int from, int *end);
+Eina_Bool      termio_search_line_match(Termio_Search *s, const Termcell *cells, int w);
+void           termio_search_start(Termio_Search *s, int x, int y, int dir);
+Eina_Bool      termio_search_match_next(Termio_Search *s, const Termio_Search_Match *cur, int dir);
+void           termio_search_shift(Termio_Search *s, int start_y, int dir);
+void           termio_search_stop(Termio_Search *s);
+Eina_Bool      termio_search_running(const Termio_Search *s);
+
+#endif
@@ -4,6 +4,7 @@
 #include "termptyesc.h"
 #include "termptyops.h"
 #include "termptysave.h"
+#include "termptylatency.h"
 #include "termio.h"
 #include <sys/types.h>
 #include <signal.h>
@@ -36,6 +37,9 @@ int _termpty_log_dom = -1;
 #define INF(...)      EINA_LOG_DOM_INFO(_termpty_log_dom, __VA_ARGS__)
 #define DBG(...)      EINA_LOG_DOM_DBG(_termpty_log_dom, __VA_ARGS__)
 
+static void _block_del(Termpty *ty, Termblock *tb);
+static Eina_Bool _block_expecting_free(const Eina_Hash *hash, const void *key, void *data, void *fdata);
+
 void
 termpty_init(void)
 {
@@ -209,6 +213,7 @@ _cb_fd_read(void *data, Ecore_Fd_Handler *fd_handler EINA_UNUSED)
           ty->oldbuf[i] = 0;
 
         len += rbuf - buf;
+        if (ty->latency) termpty_latency_read(ty->latency, buf, len);
 
         /*
         printf(" I: ");
@@ -264,6 +269,8 @@ _cb_fd_read(void *data, Ecore_Fd_Handler *fd_handler EINA_UNUSED)
 //        DBG("---------------- handle buf %i", j);
         _handle_buf(ty, codepoint, j);
      }
+   if (ty->latency)
+     termpty_latency_stage(ty->latency, TERMPTY_LATENCY_PARSE);
    if (ty->cb.change.func) ty->cb.change.func(ty->cb.change.data);
    return EINA_TRUE;
 }
@@ -297,6 +304,7 @@ termpty_new(const char *cmd, Eina_Bool login_shell, const char *cd,
 
    ty = calloc(1, sizeof(Termpty));
    if (!ty) return NULL;
+   eina_lock_new(&ty->backlock.lock);
    ty->w = w;
    ty->h = h;
    ty->backsize = backscroll;
@@ -320,6 +328,10 @@ termpty_new(const char *cmd, Eina_Bool login_shell, const char *cd,
 
    ty->circular_offset = 0;
 
+   /* opt-in, see termptylatency.c */
+   if (getenv("TERMINOLOGY_LATENCY"))
+     ty->latency = termpty_latency_new();
+
    needs_shell = ((!cmd) ||
                   (strpbrk(cmd, " |&;<>()$`\\\"'*?#") != NULL));
    DBG("cmd='%s' needs_shell=%u", cmd ? cmd : "", needs_shell);
@@ -507,8 +519,10 @@ termpty_new(const char *cmd, Eina_Bool login_shell, const char *cd,
 err:
    free(ty->screen);
    free(ty->screen2);
+   termpty_latency_free(ty->latency);
    if (ty->fd >= 0) close(ty->fd);
    if (ty->slavefd >= 0) close(ty->slavefd);
+   eina_lock_free(&ty->backlock.lock);
    free(ty);
    return NULL;
 }
@@ -516,13 +530,24 @@ err:
 void
 termpty_free(Termpty *ty)
 {
-   Termexp *ex;
-
    termpty_save_unregister(ty);
-   EINA_LIST_FREE(ty->block.expecting, ex) free(ex);
-   if (ty->block.blocks) eina_hash_free(ty->block.blocks);
-   if (ty->block.chid_map) eina_hash_free(ty->block.chid_map);
+   termpty_latency_free(ty->latency);
+   if (ty->block.expecting)
+     {
+        eina_hash_foreach(ty->block.expecting, _block_expecting_free, NULL);
+        eina_hash_free(ty->block.expecting);
+     }
    if (ty->block.active) eina_list_free(ty->block.active);
+   ty->block.active = NULL;
+   if (ty->block.blocks)
+     {
+        int id;
+
+        for (id = 0; id < TERMPTY_BLOCKS_MAX; id++)
+          if (ty->block.blocks[id]) _block_del(ty, ty->block.blocks[id]);
+        free(ty->block.blocks);
+     }
+   if (ty->block.chid_map) eina_hash_free(ty->block.chid_map);
    if (ty->fd >= 0) close(ty->fd);
    if (ty->slavefd >= 0) close(ty->slavefd);
    if (ty->pid >= 0)
@@ -569,12 +594,14 @@ termpty_free(Termpty *ty)
         size_t i;
 
         for (i = 0; i < ty->backsize; i++)
-          termpty_save_free(&ty->back[i]);
+          termpty_save_free(ty, &ty->back[i]);
         free(ty->back);
      }
+   termpty_save_cleanup(ty);
    free(ty->screen);
    free(ty->screen2);
    free(ty->buf);
+   eina_lock_free(&ty->backlock.lock);
    free(ty);
 }
 
@@ -623,8 +650,14 @@ termpty_line_length(const Termcell *cells, ssize_t nb_cells)
    return 0;
 }
 
+#if defined(BACKLOG_LOCK_DEBUG)
 #define BACKLOG_ROW_GET(Ty, Y) \
-   (&Ty->back[(Ty->backsize + ty->backpos - ((Y) - 1 )) % Ty->backsize])
+   (termpty_backlog_lock_check(Ty, __func__), \
+    &Ty->back[(Ty->backsize + Ty->backpos - ((Y) - 1 )) % Ty->backsize])
+#else
+#define BACKLOG_ROW_GET(Ty, Y) \
+   (&Ty->back[(Ty->backsize + Ty->backpos - ((Y) - 1 )) % Ty->backsize])
+#endif
 
 
 #if 0
@@ -678,7 +711,7 @@ termpty_text_save_top(Termpty *ty, Termcell *cells, ssize_t w_max)
      return;
    assert(ty->back);
 
-   termpty_backlog_lock();
+   termpty_backlog_lock(ty);
 
    w = termpty_line_length(cells, w_max);
    if (ty->backsize >= 1)
@@ -687,26 +720,38 @@ termpty_text_save_top(Termpty *ty, Termcell *cells, ssize_t w_max)
         if (!ts->cells)
           goto add_new_ts;
         /* TODO: RESIZE uncompress ? */
-        if (ts->w && ts->cells[ts->w - 1].att.autowrapped)
+        if (!ts->comp && ts->w && ts->cells[ts->w - 1].att.autowrapped)
           {
              int old_len = ts->w;
-             termpty_save_expand(ts, cells, w);
-             ty->backlog_beacon.screen_y += (ts->w + ty->w - 1) / ty->w
-                                          - (old_len + ty->w - 1) / ty->w;
+             int added;
+
+             termpty_save_expand(ty, ts, cells, w);
+             termpty_save_index_expand(ty, ts, old_len);
+             termpty_save_summary_expand(ty, ts);
+             added = (ts->w + ty->w - 1) / ty->w
+                     - (old_len + ty->w - 1) / ty->w;
+             ty->backlog_beacon.screen_y += added;
+             ty->backlog_pushed += added;
+             termpty_backlog_unlock(ty);
              return;
           }
      }
 
 add_new_ts:
    ts = BACKLOG_ROW_GET(ty, 0);
-   ts = termpty_save_new(ts, w);
+   ts = termpty_save_add(ty, ts, cells, w);
    if (!ts)
-     return;
-   termpty_cell_copy(ty, cells, ts->cells, w);
+     {
+        termpty_backlog_unlock(ty);
+        return;
+     }
+   termpty_save_index_add(ty, cells, w);
+   termpty_save_summary_add(ty, cells, w);
    ty->backpos++;
    if (ty->backpos >= ty->backsize)
      ty->backpos = 0;
-   termpty_backlog_unlock();
+   ty->backlog_pushed++;
+   termpty_backlog_unlock(ty);
 
    ty->backlog_beacon.screen_y++;
    ty->backlog_beacon.backlog_y++;
@@ -793,8 +838,11 @@ termpty_backscroll_adjust(Termpty *ty, int *scroll)
      }
 }
 
-static Termcell*
-_termpty_cellrow_from_beacon_get(Termpty *ty, int requested_y, ssize_t *wret)
+/* finds the backlog row holding screen row requested_y (negative), delta
+ * being how many screen rows of it come after that one.  The beacon is
+ * left on it */
+static Termsave *
+_termpty_backlog_row_find(Termpty *ty, int requested_y, int *delta)
 {
    int backlog_y = ty->backlog_beacon.backlog_y;
    int screen_y = ty->backlog_beacon.screen_y;
@@ -822,13 +870,10 @@ _termpty_cellrow_from_beacon_get(Termpty *ty, int requested_y, ssize_t *wret)
 
         if ((screen_y <= requested_y) && (requested_y < screen_y + nb_lines))
           {
-             int delta = screen_y + nb_lines - 1 - requested_y;
-             *wret = ts->w - delta * ty->w;
-             if (*wret > ts->w)
-               *wret = ts->w;
+             *delta = screen_y + nb_lines - 1 - requested_y;
              ty->backlog_beacon.screen_y = screen_y;
              ty->backlog_beacon.backlog_y = backlog_y;
-             return &ts->cells[delta * ty->w];
+             return ts;
           }
 
         if (requested_y > screen_y)
@@ -846,6 +891,38 @@ _termpty_cellrow_from_beacon_get(Termpty *ty, int requested_y, ssize_t *wret)
    return NULL;
 }
 
+static Termcell*
+_termpty_cellrow_from_beacon_get(Termpty *ty, int requested_y, ssize_t *wret)
+{
+   Termsave *ts;
+   Termcell *cells;
+   int delta = 0;
+
+   ts = _termpty_backlog_row_find(ty, requested_y, &delta);
+   if (!ts)
+     return NULL;
+   cells = termpty_save_cells_get(ty, ts);
+   if (!cells)
+     return NULL;
+   *wret = ts->w - delta * ty->w;
+   if (*wret > ts->w)
+     *wret = ts->w;
+   return &cells[delta * ty->w];
+}
+
+/* backlog row (1 being the newest) holding screen row y, or 0 */
+int
+termpty_backlog_row_get(Termpty *ty, int y)
+{
+   int delta = 0;
+
+   if ((y >= 0) || (!ty->back))
+     return 0;
+   if (!_termpty_backlog_row_find(ty, y, &delta))
+     return 0;
+   return ty->backlog_beacon.backlog_y;
+}
+
 Termcell *
 termpty_cellrow_get(Termpty *ty, int y_requested, ssize_t *wret)
 {
@@ -863,10 +940,23 @@ termpty_cellrow_get(Termpty *ty, int y_requested, ssize_t *wret)
 
 }
 
+/* whether row y of the backlog, of w cells as got from
+ * termpty_cellrow_get(), may still change: the newest line of the backlog
+ * grows while it ends autowrapped, see termpty_text_save_top(), and its
+ * last row gets the new cells when it is not full */
+Eina_Bool
+termpty_backlog_row_open(const Termpty *ty, int y, const Termcell *cells,
+                         ssize_t w)
+{
+   return ((y == -1) && (cells) && (w > 0) && (w < ty->w) &&
+           (cells[w - 1].att.autowrapped));
+}
+
 void
 termpty_write(Termpty *ty, const char *input, int len)
 {
    if (ty->fd < 0) return;
+   if (ty->latency) termpty_latency_write(ty->latency, input, len);
    if (write(ty->fd, input, len) < 0)
      ERR(_("Could not write to file descriptor %d: %s"),
          ty->fd, strerror(errno));
@@ -978,7 +1068,7 @@ termpty_resize(Termpty *ty, int new_w, int new_h)
    if ((new_w == new_h) && (new_w == 1)) return; // FIXME: something weird is
                                                  // going on at term init
 
-   termpty_backlog_lock();
+   termpty_backlog_lock(ty);
 
    if (ty->altbuf)
      {
@@ -1043,7 +1133,7 @@ termpty_resize(Termpty *ty, int new_w, int new_h)
 
    _pty_size(ty);
 
-   termpty_backlog_unlock();
+   termpty_backlog_unlock(ty);
 
    ty->backlog_beacon.backlog_y = 1;
    ty->backlog_beacon.screen_y = 1;
@@ -1051,7 +1141,7 @@ termpty_resize(Termpty *ty, int new_w, int new_h)
    return;
 
 bad:
-   termpty_backlog_unlock();
+   termpty_backlog_unlock(ty);
    free(new_screen);
 }
 
@@ -1062,14 +1152,14 @@ termpty_backlog_size_set(Termpty *ty, size_t size)
      return;
 
    /* TODO: RESIZE: handle that case better: changing backscroll size */
-   termpty_backlog_lock();
+   termpty_backlog_lock(ty);
 
    if (ty->back)
      {
         size_t i;
 
         for (i = 0; i < ty->backsize; i++)
-          termpty_save_free(&ty->back[i]);
+          termpty_save_free(ty, &ty->back[i]);
         free(ty->back);
      }
    if (size > 0)
@@ -1078,7 +1168,9 @@ termpty_backlog_size_set(Termpty *ty, size_t size)
      ty->back = NULL;
    ty->backpos = 0;
    ty->backsize = size;
-   termpty_backlog_unlock();
+   termpty_save_index_reset(ty);
+   termpty_save_summary_reset(ty);
+   termpty_backlog_unlock(ty);
 }
 
 pid_t
@@ -1099,6 +1191,18 @@ termpty_block_free(Termblock *tb)
    free(tb);
 }
 
+/* forgets about the block before freeing it */
+static void
+_block_del(Termpty *ty, Termblock *tb)
+{
+   if (tb->active)
+     ty->block.active = eina_list_remove(ty->block.active, tb);
+   if ((tb->chid) && (ty->block.chid_map))
+     eina_hash_del(ty->block.chid_map, tb->chid, tb);
+   ty->block.blocks[tb->id] = NULL;
+   termpty_block_free(tb);
+}
+
 Termblock *
 termpty_block_new(Termpty *ty, int w, int h, const char *path, const char *link)
 {
@@ -1107,15 +1211,10 @@ termpty_block_new(Termpty *ty, int w, int h, const char *path, const char *link)
    
    id = ty->block.curid;
    if (!ty->block.blocks)
-     ty->block.blocks = eina_hash_int32_new((Eina_Free_Cb)termpty_block_free);
+     ty->block.blocks = calloc(TERMPTY_BLOCKS_MAX, sizeof(Termblock *));
    if (!ty->block.blocks) return NULL;
-   tb = eina_hash_find(ty->block.blocks, &id);
-   if (tb)
-     {
-        if (tb->active)
-          ty->block.active = eina_list_remove(ty->block.active, tb);
-        eina_hash_del(ty->block.blocks, &id, tb);
-     }
+   tb = ty->block.blocks[id];
+   if (tb) _block_del(ty, tb);
    tb = calloc(1, sizeof(Termblock));
    if (!tb) return NULL;
    tb->pty = ty;
@@ -1124,9 +1223,9 @@ termpty_block_new(Termpty *ty, int w, int h, const char *path, const char *link)
    tb->h = h;
    tb->path = eina_stringshare_add(path);
    if (link) tb->link = eina_stringshare_add(link);
-   eina_hash_add(ty->block.blocks, &id, tb);
+   ty->block.blocks[id] = tb;
    ty->block.curid++;
-   if (ty->block.curid >= 8192) ty->block.curid = 0;
+   if (ty->block.curid >= TERMPTY_BLOCKS_MAX) ty->block.curid = 0;
    return tb;
 }
 
@@ -1142,6 +1241,7 @@ termpty_block_insert(Termpty *ty, int ch, Termblock *blk)
    // 
    // cp = (1 << 31) | ((id 0x1fff) << 18) | ((x & 0x1ff) << 9) | (y & 0x1ff);
    Termexp *ex;
+   Eina_List *l;
    
    ex = calloc(1, sizeof(Termexp));
    if (!ex) return;
@@ -1150,7 +1250,56 @@ termpty_block_insert(Termpty *ty, int ch, Termblock *blk)
    ex->id = blk->id;
    ex->w = blk->w;
    ex->h = blk->h;
-   ty->block.expecting = eina_list_append(ty->block.expecting, ex);
+   if (!ty->block.expecting)
+     ty->block.expecting = eina_hash_int32_new(NULL);
+   if (!ty->block.expecting)
+     {
+        free(ex);
+        return;
+     }
+   l = eina_hash_find(ty->block.expecting, &ch);
+   eina_hash_set(ty->block.expecting, &ch, eina_list_append(l, ex));
+}
+
+/* the expectation the given character is to be replaced for, that is the
+ * first one for that character to be inserted that is not done yet */
+Termexp *
+termpty_block_expecting_get(Termpty *ty, int ch)
+{
+   if (!ty->block.expecting) return NULL;
+   return eina_list_data_get(eina_hash_find(ty->block.expecting, &ch));
+}
+
+void
+termpty_block_expecting_del(Termpty *ty, Termexp *ex)
+{
+   Eina_List *l;
+
+   l = eina_hash_find(ty->block.expecting, &ex->ch);
+   l = eina_list_remove(l, ex);
+   if (l)
+     eina_hash_set(ty->block.expecting, &ex->ch, l);
+   else
+     eina_hash_del_by_key(ty->block.expecting, &ex->ch);
+   free(ex);
+   /* back to plain text handling */
+   if (!eina_hash_population(ty->block.expecting))
+     {
+        eina_hash_free(ty->block.expecting);
+        ty->block.expecting = NULL;
+     }
+}
+
+static Eina_Bool
+_block_expecting_free(const Eina_Hash *hash EINA_UNUSED,
+                      const void *key EINA_UNUSED,
+                      void *data, void *fdata EINA_UNUSED)
+{
+   Eina_List *l = data;
+   Termexp *ex;
+
+   EINA_LIST_FREE(l, ex) free(ex);
+   return EINA_TRUE;
 }
 
 int
@@ -1165,13 +1314,6 @@ termpty_block_id_get(Termcell *cell, int *x, int *y)
    return id;
 }
 
-Termblock *
-termpty_block_get(Termpty *ty, int id)
-{
-   if (!ty->block.blocks) return NULL;
-   return eina_hash_find(ty->block.blocks, &id);
-}
-
 void
 termpty_block_chid_update(Termpty *ty, Termblock *blk)
 {
@@ -1208,9 +1350,7 @@ _handle_block_codepoint_overwrite_heavy(Termpty *ty, int oldc, int newc)
         tb->refs--;
         if (tb->refs == 0)
           {
-             if (tb->active)
-               ty->block.active = eina_list_remove(ty->block.active, tb);
-             eina_hash_del(ty->block.blocks, &ido, tb);
+             _block_del(ty, tb);
           }
      }
    
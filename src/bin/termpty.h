@@ -8,8 +8,12 @@ typedef struct _Termcell      Termcell;
 typedef struct _Termatt       Termatt;
 typedef struct _Termsave      Termsave;
 typedef struct _Termsavecomp  Termsavecomp;
+typedef struct _Termsave_Cache Termsave_Cache;
+typedef struct _Termsave_Index Termsave_Index;
+typedef struct _Termsave_Summary Termsave_Summary;
 typedef struct _Termblock     Termblock;
 typedef struct _Termexp       Termexp;
+typedef struct _Termpty_Latency Termpty_Latency;
 
 #define COL_DEF        0
 #define COL_BLACK      1
@@ -44,6 +48,10 @@ typedef struct _Termexp       Termexp;
 // Only for testing purpose
 //#define SUPPORT_80_132_COLUMNS 1
 
+/* complain about every access to the backlog done without holding
+ * termpty_backlog_lock() */
+//#define BACKLOG_LOCK_DEBUG 1
+
 #define MOVIE_STATE_PLAY   0
 #define MOVIE_STATE_PAUSE  1
 #define MOVIE_STATE_STOP   2
@@ -106,18 +114,36 @@ struct _Termpty
    unsigned char oldbuf[4];
    Termsave *back;
    size_t backsize, backpos;
+   size_t backmem; /* bytes of cells held in back, see termptysave.c */
+   struct {
+      Eina_Hash    *rows;
+      unsigned long lines, hits;
+   } backdedup;
+   Termsave_Cache *backcache; /* unpacked backlog rows */
+   Termsave_Index *backindex; /* trigrams of the backlog, for searching */
+   Termsave_Summary *backsummary; /* the backlog scaled down, see miniview */
+   Termpty_Latency *latency; /* keystroke latency tracer, usually NULL */
    struct {
         int screen_y;
         int backlog_y;
    } backlog_beacon;
+   /* screen rows ever added to the backlog, so that a row can be named
+    * by backlog_pushed + y whatever is printed after it */
+   long backlog_pushed;
+   /* protects back, screen and screen2, see termpty_backlog_lock() */
+   struct {
+      Eina_Lock   lock;
+      Eina_Thread owner;
+      int         depth;
+   } backlock;
    int w, h;
    int fd, slavefd;
    struct {
       int curid;
-      Eina_Hash *blocks;
+      Termblock **blocks; /* TERMPTY_BLOCKS_MAX, indexed by id */
       Eina_Hash *chid_map;
       Eina_List *active;
-      Eina_List *expecting;
+      Eina_Hash *expecting; /* Eina_List of Termexp by replace character */
       unsigned char on : 1;
    } block;
    struct {
@@ -166,6 +192,7 @@ struct _Termpty
    unsigned int mouse_mode : 3;
    unsigned int mouse_ext  : 2;
    unsigned int bracketed_paste : 1;
+   unsigned int sync_update : 1; /* hold rendering, DECSET 2026 */
 };
 
 struct _Termcell
@@ -182,6 +209,7 @@ struct _Termsave
    unsigned int   z    : 1;
    unsigned int   w    : 22;
    /* TODO: union ? */
+   /* packed when comp is set, use termpty_save_cells_get() */
    Termcell       *cells;
 };
 
@@ -201,6 +229,8 @@ struct _Termblock
    const char  *path, *link, *chid;
    Evas_Object *obj;
    Eina_List   *cmds;
+   Eina_List   *cached; /* node in the cache of hidden objects, see termio.c */
+   size_t       cached_mem; /* what it is accounted for in that cache */
    int          id;
    int          type;
    int          refs;
@@ -217,8 +247,22 @@ struct _Termblock
    unsigned char was_active_before : 1;
 
    unsigned char mov_state : 2;  // movie state marker
+   unsigned char geometry_set : 1; // obj was given ox/oy/ow/oh
+
+   Evas_Coord   ox, oy, ow, oh;
 };
 
+/* ids are 13 bits of the cell codepoint, see termpty_block_insert() */
+#define TERMPTY_BLOCKS_MAX 8192
+
+static inline Termblock *
+termpty_block_get(const Termpty *ty, int id)
+{
+   if ((!ty->block.blocks) || (id < 0) || (id >= TERMPTY_BLOCKS_MAX))
+     return NULL;
+   return ty->block.blocks[id];
+}
+
 struct _Termexp
 {
    int ch, left, id;
@@ -233,15 +277,19 @@ Termpty   *termpty_new(const char *cmd, Eina_Bool login_shell, const char *cd,
                       Eina_Bool erase_is_del, const char *emotion_mod);
 void       termpty_free(Termpty *ty);
 
-void       termpty_backlog_lock(void);
-void       termpty_backlog_unlock(void);
+void       termpty_backlog_lock(Termpty *ty);
+void       termpty_backlog_unlock(Termpty *ty);
+Eina_Bool  termpty_backlog_locked(const Termpty *ty);
+void       termpty_backlog_lock_check(const Termpty *ty, const char *func);
 
 Termcell  *termpty_cellrow_get(Termpty *ty, int y, ssize_t *wret);
+Eina_Bool  termpty_backlog_row_open(const Termpty *ty, int y, const Termcell *cells, ssize_t w);
 ssize_t termpty_row_length(Termpty *ty, int y);
 void       termpty_write(Termpty *ty, const char *input, int len);
 void       termpty_resize(Termpty *ty, int new_w, int new_h);
 void       termpty_backlog_size_set(Termpty *ty, size_t size);
 ssize_t    termpty_backlog_length(Termpty *ty);
+int        termpty_backlog_row_get(Termpty *ty, int y);
 void       termpty_backscroll_adjust(Termpty *ty, int *scroll);
 
 pid_t      termpty_pid_get(const Termpty *ty);
@@ -249,9 +297,10 @@ void       termpty_block_free(Termblock *tb);
 Termblock *termpty_block_new(Termpty *ty, int w, int h, const char *path, const char *link);
 void       termpty_block_insert(Termpty *ty, int ch, Termblock *blk);
 int        termpty_block_id_get(Termcell *cell, int *x, int *y);
-Termblock *termpty_block_get(Termpty *ty, int id);
 void       termpty_block_chid_update(Termpty *ty, Termblock *blk);
 Termblock *termpty_block_chid_get(Termpty *ty, const char *chid);
+Termexp   *termpty_block_expecting_get(Termpty *ty, int ch);
+void       termpty_block_expecting_del(Termpty *ty, Termexp *ex);
 
 void       termpty_cell_copy(Termpty *ty, Termcell *src, Termcell *dst, int n);
 void       termpty_cell_fill(Termpty *ty, Termcell *src, Termcell *dst, int n);
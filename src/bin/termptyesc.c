@@ -6,6 +6,7 @@
 #include "termptyesc.h"
 #include "termptyops.h"
 #include "termptyext.h"
+#include "col.h"
 #if defined(SUPPORT_80_132_COLUMNS)
 #include "termio.h"
 #endif
@@ -374,6 +375,12 @@ _handle_esc_csi_reset_mode(Termpty *ty, Eina_Unicode cc, Eina_Unicode *b)
                      case 2004:
                         ty->bracketed_paste = mode;
                         break;
+                     case 2026:
+                        /* synchronized update: the screen is being
+                         * repainted, do not show it until done */
+                        ty->sync_update = mode;
+                        DBG("synchronized update %i", mode);
+                        break;
                      case 7727: // ignore
                         WRN("TODO: enable application escape mode %i", mode);
                         break;
@@ -1408,10 +1415,9 @@ _handle_esc_xterm(Termpty *ty, const Eina_Unicode *c, Eina_Unicode *ce)
              len = cc - c - (p - buf);
              if (_xterm_parse_color(&p, &r, &g, &b, len) < 0)
                goto err;
-             evas_object_textgrid_palette_set(
-                termio_textgrid_get(ty->obj),
-                EVAS_TEXTGRID_PALETTE_STANDARD, 0,
-                r, g, b, 0xff);
+             colors_palette_set(termio_textgrid_get(ty->obj),
+                                EVAS_TEXTGRID_PALETTE_STANDARD, 0,
+                                r, g, b, 0xff);
           }
         break;
       case 777:
@@ -1848,36 +1854,26 @@ termpty_handle_seq(Termpty *ty, Eina_Unicode *c, Eina_Unicode *ce)
    else if ((ty->block.expecting) && (ty->block.on))
      {
         Termexp *ex;
-        Eina_List *l;
         
         ty->termstate.had_cr = 0;
-        EINA_LIST_FOREACH(ty->block.expecting, l, ex)
+        ex = termpty_block_expecting_get(ty, c[0]);
+        if (ex)
           {
-             if (c[0] == ex->ch)
-               {
-                  Eina_Unicode cp;
+             Eina_Unicode cp;
              
-                  cp = (1 << 31) | ((ex->id & 0x1fff) << 18) |
-                    ((ex->x & 0x1ff) << 9) | (ex->y & 0x1ff);
-                  ex->x++;
-                  if (ex->x >= ex->w)
-                    {
-                       ex->x = 0;
-                       ex->y++;
-                    }
-                  ex->left--;
-                  termpty_text_append(ty, &cp, 1);
-                  if (ex->left <= 0)
-                    {
-                       ty->block.expecting = 
-                         eina_list_remove_list(ty->block.expecting, l);
-                       free(ex);
-                    }
-                  else
-                    ty->block.expecting =
-                    eina_list_promote_list(ty->block.expecting, l);
-                  return 1;
+             cp = (1 << 31) | ((ex->id & 0x1fff) << 18) |
+               ((ex->x & 0x1ff) << 9) | (ex->y & 0x1ff);
+             ex->x++;
+             if (ex->x >= ex->w)
+               {
+                  ex->x = 0;
+                  ex->y++;
                }
+             ex->left--;
+             termpty_text_append(ty, &cp, 1);
+             if (ex->left <= 0)
+               termpty_block_expecting_del(ty, ex);
+             return 1;
           }
         termpty_text_append(ty, c, 1);
         return 1;
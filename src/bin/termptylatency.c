@@ -0,0 +1,311 @@
+#include "private.h"
+#include <Elementary.h>
+#include "termpty.h"
+#include "termptylatency.h"
+
+#undef CRITICAL
+#undef ERR
+#undef WRN
+#undef INF
+#undef DBG
+
+#define CRITICAL(...) EINA_LOG_DOM_CRIT(_termpty_log_dom, __VA_ARGS__)
+#define ERR(...)      EINA_LOG_DOM_ERR(_termpty_log_dom, __VA_ARGS__)
+#define WRN(...)      EINA_LOG_DOM_WARN(_termpty_log_dom, __VA_ARGS__)
+#define INF(...)      EINA_LOG_DOM_INFO(_termpty_log_dom, __VA_ARGS__)
+#define DBG(...)      EINA_LOG_DOM_DBG(_termpty_log_dom, __VA_ARGS__)
+
+/* Keypress to photon latency
+ *
+ * Every key event that writes to the pty is kept in a small queue along
+ * with the bytes it wrote, and time stamped as it goes through the
+ * stages of Termpty_Latency_Stage.  Reads from the pty are searched for
+ * the echo of the queued keys, in order, printable keys having to be
+ * found in what was read while other keys (control characters, escape
+ * sequences) are matched by the first read after them, applications
+ * usually answering them with a redraw rather than an echo.  Once
+ * rendered, the time spent in each stage goes in a histogram of
+ * TERMPTY_LATENCY_BUCKET wide buckets, the first histogram being the
+ * whole trip.  Keys that do not get through in TERMPTY_LATENCY_TIMEOUT
+ * seconds, such as the ones typed at a password prompt, are dropped and
+ * only counted.
+ */
+
+#define TERMPTY_LATENCY_PENDING 32
+#define TERMPTY_LATENCY_BYTES   8
+#define TERMPTY_LATENCY_TIMEOUT 2.0
+#define TERMPTY_LATENCY_BUCKET  0.0001
+#define TERMPTY_LATENCY_BUCKETS 1000
+
+typedef struct _Latency_Key Latency_Key;
+typedef struct _Latency_Histogram Latency_Histogram;
+
+struct _Latency_Key
+{
+   double t[TERMPTY_LATENCY_STAGES];
+   char bytes[TERMPTY_LATENCY_BYTES];
+   unsigned char len;
+   unsigned char stage;
+};
+
+struct _Latency_Histogram
+{
+   /* the last bucket holds everything above the others */
+   unsigned int buckets[TERMPTY_LATENCY_BUCKETS + 1];
+   unsigned int count;
+   double max;
+};
+
+struct _Termpty_Latency
+{
+   Latency_Key pending[TERMPTY_LATENCY_PENDING];
+   int first, n;
+   Eina_Bool in_key;
+   unsigned int lost;
+   Latency_Histogram hist[TERMPTY_LATENCY_STAGES];
+};
+
+static const char *const _stage_names[TERMPTY_LATENCY_STAGES] =
+{
+   "total", "write", "read", "parse", "apply", "render"
+};
+
+#define PENDING(_lat, _i) \
+   (&(_lat)->pending[((_lat)->first + (_i)) % TERMPTY_LATENCY_PENDING])
+
+Termpty_Latency *
+termpty_latency_new(void)
+{
+   return calloc(1, sizeof(Termpty_Latency));
+}
+
+void
+termpty_latency_free(Termpty_Latency *lat)
+{
+   const Latency_Histogram *h;
+
+   if (!lat) return;
+   h = &lat->hist[0];
+   if (h->count)
+     INF("%u keys traced, %u lost, slowest took %.2fms",
+         h->count, lat->lost, h->max * 1000.0);
+   free(lat);
+}
+
+void
+termpty_latency_reset(Termpty_Latency *lat)
+{
+   lat->lost = 0;
+   memset(lat->hist, 0, sizeof(lat->hist));
+}
+
+static void
+_pending_drop_first(Termpty_Latency *lat)
+{
+   lat->first = (lat->first + 1) % TERMPTY_LATENCY_PENDING;
+   lat->n--;
+}
+
+static void
+_pending_expire(Termpty_Latency *lat, double t)
+{
+   while ((lat->n > 0) && (!lat->in_key || lat->n > 1) &&
+          (t - PENDING(lat, 0)->t[TERMPTY_LATENCY_KEY] >
+           TERMPTY_LATENCY_TIMEOUT))
+     {
+        _pending_drop_first(lat);
+        lat->lost++;
+     }
+}
+
+static void
+_histogram_add(Latency_Histogram *h, double d)
+{
+   int b;
+
+   if (d < 0.0) d = 0.0;
+   b = d / TERMPTY_LATENCY_BUCKET;
+   if (b > TERMPTY_LATENCY_BUCKETS) b = TERMPTY_LATENCY_BUCKETS;
+   h->buckets[b]++;
+   h->count++;
+   if (d > h->max) h->max = d;
+}
+
+/* upper bound of the bucket holding the given fraction of the samples */
+static double
+_histogram_percentile(const Latency_Histogram *h, double fraction)
+{
+   unsigned int want, seen = 0;
+   int b;
+
+   if (!h->count) return 0.0;
+   want = (unsigned int)(h->count * fraction);
+   if (want < 1) want = 1;
+   for (b = 0; b < TERMPTY_LATENCY_BUCKETS; b++)
+     {
+        seen += h->buckets[b];
+        if (seen >= want)
+          {
+             double d = (b + 1) * TERMPTY_LATENCY_BUCKET;
+
+             return (d < h->max) ? d : h->max;
+          }
+     }
+   return h->max;
+}
+
+static void
+_key_record(Termpty_Latency *lat, const Latency_Key *key)
+{
+   int s;
+
+   _histogram_add(&lat->hist[0], key->t[TERMPTY_LATENCY_RENDER] -
+                  key->t[TERMPTY_LATENCY_KEY]);
+   for (s = TERMPTY_LATENCY_WRITE; s < TERMPTY_LATENCY_STAGES; s++)
+     _histogram_add(&lat->hist[s], key->t[s] - key->t[s - 1]);
+}
+
+void
+termpty_latency_key_begin(Termpty_Latency *lat)
+{
+   Latency_Key *key;
+   double t = ecore_time_get();
+
+   if (lat->in_key) termpty_latency_key_end(lat);
+   _pending_expire(lat, t);
+   if (lat->n == TERMPTY_LATENCY_PENDING)
+     {
+        _pending_drop_first(lat);
+        lat->lost++;
+     }
+   key = PENDING(lat, lat->n);
+   lat->n++;
+   memset(key, 0, sizeof(*key));
+   key->t[TERMPTY_LATENCY_KEY] = t;
+   key->stage = TERMPTY_LATENCY_KEY;
+   lat->in_key = EINA_TRUE;
+}
+
+void
+termpty_latency_key_end(Termpty_Latency *lat)
+{
+   if (!lat->in_key) return;
+   lat->in_key = EINA_FALSE;
+   /* handled by terminology itself, nothing to wait for */
+   if (PENDING(lat, lat->n - 1)->stage == TERMPTY_LATENCY_KEY)
+     lat->n--;
+}
+
+void
+termpty_latency_write(Termpty_Latency *lat, const char *buf, int len)
+{
+   Latency_Key *key;
+   int n;
+
+   if (!lat->in_key) return;
+   key = PENDING(lat, lat->n - 1);
+   n = TERMPTY_LATENCY_BYTES - key->len;
+   if (n > len) n = len;
+   memcpy(key->bytes + key->len, buf, n);
+   key->len += n;
+   key->t[TERMPTY_LATENCY_WRITE] = ecore_time_get();
+   key->stage = TERMPTY_LATENCY_WRITE;
+}
+
+static Eina_Bool
+_key_printable(const Latency_Key *key)
+{
+   int i;
+
+   for (i = 0; i < key->len; i++)
+     {
+        unsigned char c = key->bytes[i];
+
+        if ((c < ' ') || (c == 0x7f)) return EINA_FALSE;
+     }
+   return EINA_TRUE;
+}
+
+static const char *
+_bytes_find(const char *buf, int len, const char *bytes, int n)
+{
+   const char *p = buf, *end = buf + len - n;
+
+   while ((p <= end) && (p = memchr(p, bytes[0], end - p + 1)))
+     {
+        if (!memcmp(p, bytes, n)) return p;
+        p++;
+     }
+   return NULL;
+}
+
+void
+termpty_latency_read(Termpty_Latency *lat, const char *buf, int len)
+{
+   double t = ecore_time_get();
+   int i, pos = 0;
+
+   _pending_expire(lat, t);
+   for (i = 0; i < lat->n; i++)
+     {
+        Latency_Key *key = PENDING(lat, i);
+
+        if (key->stage > TERMPTY_LATENCY_WRITE) continue;
+        if (key->stage < TERMPTY_LATENCY_WRITE) break;
+        if (_key_printable(key))
+          {
+             const char *p;
+
+             p = _bytes_find(buf + pos, len - pos, key->bytes, key->len);
+             /* keep the order, a later key cannot be echoed first */
+             if (!p) break;
+             pos = p - buf + key->len;
+          }
+        key->t[TERMPTY_LATENCY_READ] = t;
+        key->stage = TERMPTY_LATENCY_READ;
+     }
+}
+
+void
+termpty_latency_stage(Termpty_Latency *lat, Termpty_Latency_Stage stage)
+{
+   double t = ecore_time_get();
+   int i;
+
+   for (i = 0; i < lat->n; i++)
+     {
+        Latency_Key *key = PENDING(lat, i);
+
+        if (key->stage != stage - 1) continue;
+        key->t[stage] = t;
+        key->stage = stage;
+     }
+   if (stage != TERMPTY_LATENCY_RENDER) return;
+   /* echoes come in order so the rendered keys are the first ones */
+   while ((lat->n > 0) &&
+          (PENDING(lat, 0)->stage == TERMPTY_LATENCY_RENDER))
+     {
+        _key_record(lat, PENDING(lat, 0));
+        _pending_drop_first(lat);
+     }
+}
+
+char *
+termpty_latency_report(const Termpty_Latency *lat)
+{
+   char buf[1024];
+   int s, len = 0;
+
+   for (s = 0; s < TERMPTY_LATENCY_STAGES; s++)
+     {
+        const Latency_Histogram *h = &lat->hist[s];
+
+        len += snprintf(buf + len, sizeof(buf) - len, "%s;%u;%i;%i;%i\n",
+                        _stage_names[s], h->count,
+                        (int)(_histogram_percentile(h, 0.50) * 1000000.0),
+                        (int)(_histogram_percentile(h, 0.99) * 1000000.0),
+                        (int)(h->max * 1000000.0));
+     }
+   snprintf(buf + len, sizeof(buf) - len, "lost;%u\n", lat->lost);
+   return strdup(buf);
+}
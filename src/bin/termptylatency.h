@@ -0,0 +1,31 @@
+#ifndef _TERMPTY_LATENCY_H__
+#define _TERMPTY_LATENCY_H__ 1
+
+/* points a keystroke goes through, from the key event to the frame
+ * showing its echo */
+typedef enum _Termpty_Latency_Stage
+{
+   TERMPTY_LATENCY_KEY,    /* key event received */
+   TERMPTY_LATENCY_WRITE,  /* bytes written to the pty */
+   TERMPTY_LATENCY_READ,   /* echo read back from the pty */
+   TERMPTY_LATENCY_PARSE,  /* echo parsed, change signalled */
+   TERMPTY_LATENCY_APPLY,  /* cells applied to the textgrid */
+   TERMPTY_LATENCY_RENDER, /* frame rendered */
+   TERMPTY_LATENCY_STAGES
+} Termpty_Latency_Stage;
+
+Termpty_Latency *termpty_latency_new(void);
+void termpty_latency_free(Termpty_Latency *lat);
+void termpty_latency_reset(Termpty_Latency *lat);
+
+void termpty_latency_key_begin(Termpty_Latency *lat);
+void termpty_latency_key_end(Termpty_Latency *lat);
+void termpty_latency_write(Termpty_Latency *lat, const char *buf, int len);
+void termpty_latency_read(Termpty_Latency *lat, const char *buf, int len);
+void termpty_latency_stage(Termpty_Latency *lat, Termpty_Latency_Stage stage);
+
+/* one line per stage "NAME;COUNT;P50;P99;MAX\n", times in microseconds,
+ * to be freed */
+char *termpty_latency_report(const Termpty_Latency *lat);
+
+#endif
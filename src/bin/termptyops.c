@@ -380,16 +380,17 @@ termpty_reset_state(Termpty *ty)
    ty->mouse_mode = MOUSE_OFF;
    ty->mouse_ext = MOUSE_EXT_NONE;
    ty->bracketed_paste = 0;
+   ty->sync_update = 0;
 
    ty->backlog_beacon.screen_y = 0;
    ty->backlog_beacon.backlog_y = 0;
 
-   termpty_backlog_lock();
+   termpty_backlog_lock(ty);
    if (ty->back)
      {
         size_t i;
         for (i = 0; i < ty->backsize; i++)
-          termpty_save_free(&ty->back[i]);
+          termpty_save_free(ty, &ty->back[i]);
         free(ty->back);
         ty->back = NULL;
      }
@@ -397,7 +398,7 @@ termpty_reset_state(Termpty *ty)
    backsize = ty->backsize;
    ty->backsize = 0;
    termpty_backlog_size_set(ty, backsize);
-   termpty_backlog_unlock();
+   termpty_backlog_unlock(ty);
 }
 
 void
@@ -2,8 +2,14 @@
 #include <Elementary.h>
 #include "termpty.h"
 #include "termptysave.h"
+#include "termptyops.h"
+#include "col.h"
 #include "lz4/lz4.h"
-#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stddef.h>
+#include <wctype.h>
 
 #if defined (__MacOSX__) || (defined (__MACH__) && defined (__APPLE__))
 # ifndef MAP_ANONYMOUS
@@ -50,22 +56,194 @@ static int ts_comp = 0;
 static int ts_uncomp = 0;
 static int ts_freeops = 0;
 static int ts_compfreeze = 0;
+/* registered ptys, least recently focused first. Only used from the
+ * main loop, so it is not covered by the backlog locks */
 static Eina_List *ptys = NULL;
 
+/* scrollback memory accounting, in bytes of saved cells */
+#define TS_IDLE_TIME 10.0
+static size_t ts_mem = 0;
+static size_t ts_budget = 0;
+static Ecore_Job *ts_budget_job = NULL;
+static Ecore_Timer *ts_idle_timer = NULL;
+static Eina_Bool ts_busy = EINA_FALSE;
+
+static void _budget_check(void);
+static void _index_trim(Termpty *ty, int y);
+static void _index_free(Termpty *ty);
+static void _summary_trim(Termpty *ty, int y);
+static void _summary_free(Termpty *ty);
+
+static void
+_mem_add(Termpty *ty, ssize_t bytes)
+{
+   ty->backmem += bytes;
+   ts_mem += bytes;
+   if (bytes > 0) _budget_check();
+}
+
+/* drop the oldest backlog rows of ty until the global usage reaches target */
+static void
+_pty_trim(Termpty *ty, size_t target)
+{
+   size_t y;
+   Eina_Bool reset_beacon = EINA_FALSE;
+
+   if (!ty->back) return;
+   for (y = ty->backsize; (y > 0) && (ts_mem > target); y--)
+     {
+        Termsave *ts = &ty->back[(ty->backpos + 1 + ty->backsize - y)
+                                 % ty->backsize];
+
+        if (!ts->cells) continue;
+        termpty_save_free(ty, ts);
+        if ((int)y <= ty->backlog_beacon.backlog_y + 1)
+          reset_beacon = EINA_TRUE;
+     }
+   /* the index and the summary have to go too, they are counted in
+    * ts_mem */
+   _index_trim(ty, (int)y);
+   _summary_trim(ty, (int)y);
+   if (reset_beacon)
+     {
+        ty->backlog_beacon.screen_y = 0;
+        ty->backlog_beacon.backlog_y = 0;
+     }
+}
+
+static void
+_budget_enforce(size_t target)
+{
+   Eina_List *l;
+   Termpty *ty, *focused;
+   size_t before = ts_mem;
+
+   if (ts_mem <= target) return;
+   focused = eina_list_last_data_get(ptys);
+   EINA_LIST_FOREACH(ptys, l, ty)
+     {
+        if (ts_mem <= target) break;
+        if (ty == focused) continue;
+        termpty_backlog_lock(ty);
+        _pty_trim(ty, target);
+        termpty_backlog_unlock(ty);
+     }
+   DBG("scrollback trimmed from %zu to %zu bytes (budget %zu)",
+       before, ts_mem, ts_budget);
+   EINA_LIST_FOREACH(ptys, l, ty)
+     DBG("  pty %p: %zu bytes, %lu of %lu lines shared", ty, ty->backmem,
+         ty->backdedup.hits, ty->backdedup.lines);
+}
+
+static void
+_cb_budget_job(void *data EINA_UNUSED)
+{
+   ts_budget_job = NULL;
+   _budget_enforce(ts_budget);
+}
+
+static Eina_Bool
+_cb_idle_timer(void *data EINA_UNUSED)
+{
+   if (ts_busy)
+     {
+        ts_busy = EINA_FALSE;
+        return ECORE_CALLBACK_RENEW;
+     }
+   ts_idle_timer = NULL;
+   /* leave some headroom so that the next burst of output does not
+    * immediately trip the budget again */
+   if (ts_budget > 0)
+     _budget_enforce(ts_budget - (ts_budget / 8));
+   return ECORE_CALLBACK_CANCEL;
+}
+
+static void
+_budget_check(void)
+{
+   if (!ts_budget) return;
+   ts_busy = EINA_TRUE;
+   if (!ts_idle_timer)
+     ts_idle_timer = ecore_timer_add(TS_IDLE_TIME, _cb_idle_timer, NULL);
+   if ((ts_mem > ts_budget) && (!ts_budget_job))
+     ts_budget_job = ecore_job_add(_cb_budget_job, NULL);
+}
+
+void
+termpty_save_budget_set(size_t bytes)
+{
+   if (ts_budget == bytes) return;
+   ts_budget = bytes;
+   if (!ts_budget)
+     {
+        if (ts_budget_job) ecore_job_del(ts_budget_job);
+        ts_budget_job = NULL;
+        if (ts_idle_timer) ecore_timer_del(ts_idle_timer);
+        ts_idle_timer = NULL;
+        return;
+     }
+   _budget_check();
+}
+
+size_t
+termpty_save_usage_get(const Termpty *ty)
+{
+   return ty->backmem;
+}
+
+size_t
+termpty_save_total_usage_get(void)
+{
+   return ts_mem;
+}
+
+void
+termpty_save_focus_set(Termpty *ty)
+{
+   if (eina_list_last_data_get(ptys) == ty) return;
+   ptys = eina_list_remove(ptys, ty);
+   ptys = eina_list_append(ptys, ty);
+}
+
 void
 termpty_save_register(Termpty *ty)
 {
-   termpty_backlog_lock();
    ptys = eina_list_append(ptys, ty);
-   termpty_backlog_unlock();
+}
+
+static void
+_stats_log(Termpty *ty)
+{
+   size_t i, rows = 0, plain = 0;
+
+   if (!ty->back) return;
+   for (i = 0; i < ty->backsize; i++)
+     {
+        if (!ty->back[i].cells) continue;
+        rows++;
+        plain += ty->back[i].w * sizeof(Termcell);
+     }
+   if (rows > 0)
+     INF("pty %p: backlog: %zu lines, %zu bytes per line (%zu unpacked)",
+         ty, rows, ty->backmem / rows, plain / rows);
 }
 
 void
 termpty_save_unregister(Termpty *ty)
 {
-   termpty_backlog_lock();
+   _stats_log(ty);
+   if (ty->backdedup.lines > 0)
+     INF("pty %p: %lu of %lu backlog lines were shared (%.1f%%)",
+         ty, ty->backdedup.hits, ty->backdedup.lines,
+         (100.0 * ty->backdedup.hits) / ty->backdedup.lines);
    ptys = eina_list_remove(ptys, ty);
-   termpty_backlog_unlock();
+   if (!ptys)
+     {
+        if (ts_budget_job) ecore_job_del(ts_budget_job);
+        ts_budget_job = NULL;
+        if (ts_idle_timer) ecore_timer_del(ts_idle_timer);
+        ts_idle_timer = NULL;
+     }
 }
 
 Termsave *
@@ -95,54 +273,1567 @@ termpty_save_extract(Termsave *ts)
    return ts;
 }
 
-Termsave *
-termpty_save_new(Termsave *ts, int w)
+/* Backlog rows
+ *
+ * The content of a backlog row lives right after a Termsave_Row header.
+ * Complete rows are packed (Termsave.comp is set): a byte giving the
+ * width of the codepoints (1 for rows that are only latin-1, 4
+ * otherwise), the codepoints, then runs of {uint16_t count, Termatt}
+ * covering the w cells.  Termsave.cells then points to that packed data
+ * and must only be read through termpty_save_cells_get(), which unpacks
+ * it into a small per-terminal cache of rows.
+ *
+ * Build logs and the like print the same lines again and again, so
+ * packed rows are looked up by content in ty->backdedup.rows and
+ * identical rows share one refcounted buffer.
+ *
+ * Rows ending with an autowrapped cell can still be extended by
+ * termpty_save_expand() and rows holding block codepoints carry per-cell
+ * references, so both are kept as plain Termcell arrays.
+ */
+
+#define TS_CACHE_SLOTS 32
+
+typedef struct _Termsave_Key Termsave_Key;
+typedef struct _Termsave_Row Termsave_Row;
+
+struct _Termsave_Key
+{
+   const unsigned char *data;
+   unsigned int         size;
+   unsigned int         hash;
+};
+
+struct _Termsave_Row
+{
+   Termsave_Key  key;
+   unsigned int  refs;
+   unsigned char hashed : 1;
+   unsigned char packed : 1;
+   Termcell      cells[];
+};
+
+struct _Termsave_Cache
+{
+   struct {
+      const Termsave_Row *row;
+      Termcell           *cells;
+      int                 w;
+   } slots[TS_CACHE_SLOTS];
+   int            next;
+   unsigned char *pack;
+   size_t         pack_size;
+};
+
+#define TS_ROW_SIZE(Bytes) (sizeof(Termsave_Row) + (Bytes))
+#define TS_ROW_GET(Cells) \
+   ((Termsave_Row *)((char *)(Cells) - offsetof(Termsave_Row, cells)))
+#define TS_PACK_RUN_SIZE (sizeof(uint16_t) + sizeof(Termatt))
+#define TS_PACK_MAX(W) (1 + (W) * (4 + TS_PACK_RUN_SIZE))
+
+static unsigned int
+_row_key_length(const void *key EINA_UNUSED)
+{
+   return 0;
+}
+
+static int
+_row_key_cmp(const void *key1, int key1_length EINA_UNUSED,
+             const void *key2, int key2_length EINA_UNUSED)
+{
+   const Termsave_Key *k1 = key1, *k2 = key2;
+
+   if (k1->hash != k2->hash)
+     return k1->hash < k2->hash ? -1 : 1;
+   if (k1->size != k2->size)
+     return k1->size < k2->size ? -1 : 1;
+   return memcmp(k1->data, k2->data, k1->size);
+}
+
+static int
+_row_key_hash(const void *key, int key_length EINA_UNUSED)
+{
+   return ((const Termsave_Key *)key)->hash;
+}
+
+static Termsave_Cache *
+_cache_get(Termpty *ty)
+{
+   if (!ty->backcache)
+     ty->backcache = calloc(1, sizeof(Termsave_Cache));
+   return ty->backcache;
+}
+
+/* packs w cells into buf, that must hold TS_PACK_MAX(w) bytes, and
+ * returns the number of bytes used */
+static size_t
+_row_pack(const Termcell *cells, int w, unsigned char *buf)
+{
+   unsigned char *p = buf;
+   uint16_t n;
+   int i, j;
+
+   *p = 1;
+   for (i = 0; i < w; i++)
+     if (cells[i].codepoint > 0xff)
+       {
+          *p = 4;
+          break;
+       }
+   p++;
+   if (*buf == 1)
+     {
+        for (i = 0; i < w; i++)
+          *p++ = cells[i].codepoint;
+     }
+   else
+     {
+        for (i = 0; i < w; i++, p += 4)
+          memcpy(p, &cells[i].codepoint, 4);
+     }
+   for (i = 0; i < w; i += n)
+     {
+        for (j = i + 1;
+             (j < w) && (j - i < 0xffff) &&
+             (!memcmp(&cells[j].att, &cells[i].att, sizeof(Termatt)));
+             j++);
+        n = j - i;
+        memcpy(p, &n, sizeof(n));
+        memcpy(p + sizeof(n), &cells[i].att, sizeof(Termatt));
+        p += TS_PACK_RUN_SIZE;
+     }
+   return p - buf;
+}
+
+static void
+_row_unpack(const unsigned char *p, int w, Termcell *cells)
+{
+   uint16_t n;
+   int i, j;
+
+   memset(cells, 0, w * sizeof(Termcell));
+   if (*p++ == 1)
+     {
+        for (i = 0; i < w; i++)
+          cells[i].codepoint = *p++;
+     }
+   else
+     {
+        for (i = 0; i < w; i++, p += 4)
+          memcpy(&cells[i].codepoint, p, 4);
+     }
+   for (i = 0; i < w; i += n)
+     {
+        memcpy(&n, p, sizeof(n));
+        if ((n == 0) || (n > w - i)) break;
+        for (j = i; j < i + n; j++)
+          memcpy(&cells[j].att, p + sizeof(n), sizeof(Termatt));
+        p += TS_PACK_RUN_SIZE;
+     }
+}
+
+static Termsave_Row *
+_row_new(Termpty *ty, size_t bytes)
+{
+   Termsave_Row *row;
+
+   row = calloc(1, TS_ROW_SIZE(bytes));
+   if (!row) return NULL;
+   row->key.data = (unsigned char *)row->cells;
+   row->key.size = bytes;
+   row->refs = 1;
+   _mem_add(ty, TS_ROW_SIZE(bytes));
+   return row;
+}
+
+static void
+_row_unref(Termpty *ty, Termsave_Row *row)
+{
+   row->refs--;
+   if (row->refs > 0) return;
+   if (row->hashed)
+     eina_hash_del_by_key(ty->backdedup.rows, &row->key);
+   if ((row->packed) && (ty->backcache))
+     {
+        int i;
+
+        for (i = 0; i < TS_CACHE_SLOTS; i++)
+          if (ty->backcache->slots[i].row == row)
+            ty->backcache->slots[i].row = NULL;
+     }
+   _mem_add(ty, -(ssize_t)TS_ROW_SIZE(row->key.size));
+   _ts_free(row);
+}
+
+/* stores cells in a packed row, shared with an identical one if any */
+static Termsave_Row *
+_row_packed_get(Termpty *ty, const Termcell *cells, int w)
+{
+   Termsave_Cache *cache = _cache_get(ty);
+   Termsave_Key key;
+   Termsave_Row *row;
+
+   if (!cache) return NULL;
+   if (cache->pack_size < TS_PACK_MAX(w))
+     {
+        unsigned char *pack = realloc(cache->pack, TS_PACK_MAX(w));
+
+        if (!pack) return NULL;
+        cache->pack = pack;
+        cache->pack_size = TS_PACK_MAX(w);
+     }
+   key.data = cache->pack;
+   key.size = _row_pack(cells, w, cache->pack);
+   key.hash = eina_hash_superfast((const char *)key.data, key.size);
+
+   if (!ty->backdedup.rows)
+     ty->backdedup.rows = eina_hash_new(_row_key_length, _row_key_cmp,
+                                        _row_key_hash, NULL, 8);
+   row = eina_hash_find(ty->backdedup.rows, &key);
+   if (row)
+     {
+        row->refs++;
+        ty->backdedup.hits++;
+        return row;
+     }
+
+   row = _row_new(ty, key.size);
+   if (!row) return NULL;
+   memcpy(row->cells, key.data, key.size);
+   row->key.hash = key.hash;
+   row->packed = 1;
+   row->hashed = eina_hash_direct_add(ty->backdedup.rows, &row->key, row);
+   return row;
+}
+
+static Eina_Bool
+_row_has_blocks(const Termcell *cells, int w)
+{
+   int i;
+
+   for (i = 0; i < w; i++)
+     if (cells[i].codepoint & 0x80000000) return EINA_TRUE;
+   return EINA_FALSE;
+}
+
+static Eina_Bool
+_row_packable(const Termcell *cells, int w)
 {
-   termpty_save_free(ts);
+   if ((w <= 0) || (cells[w - 1].att.autowrapped)) return EINA_FALSE;
+   /* blocks are refcounted per cell */
+   return !_row_has_blocks(cells, w);
+}
 
-   Termcell *cells = calloc(1, w * sizeof(Termcell));
-   if (!cells ) return NULL;
-   ts->cells = cells;
+static void
+_save_set(Termsave *ts, Termsave_Row *row, int w)
+{
+   ts->cells = row->cells;
    ts->w = w;
+   ts->comp = row->packed;
+   if (!ts_compfreeze)
+     {
+        if (ts->comp) ts_comp++;
+        else ts_uncomp++;
+     }
+}
+
+Termsave *
+termpty_save_new(Termpty *ty, Termsave *ts, int w)
+{
+   Termsave_Row *row;
+
+   termpty_save_free(ty, ts);
+
+   row = _row_new(ty, w * sizeof(Termcell));
+   if (!row) return NULL;
+   _save_set(ts, row, w);
+   return ts;
+}
+
+Termsave *
+termpty_save_add(Termpty *ty, Termsave *ts, Termcell *cells, int w)
+{
+   Termsave_Row *row;
+
+   termpty_save_free(ty, ts);
+
+   ty->backdedup.lines++;
+   if (!_row_packable(cells, w))
+     {
+        if (!termpty_save_new(ty, ts, w)) return NULL;
+        termpty_cell_copy(ty, cells, ts->cells, w);
+        return ts;
+     }
+   row = _row_packed_get(ty, cells, w);
+   if (!row) return NULL;
+   _save_set(ts, row, w);
    return ts;
 }
 
 Termsave *
-termpty_save_expand(Termsave *ts, Termcell *cells, size_t delta)
+termpty_save_expand(Termpty *ty, Termsave *ts, Termcell *cells, size_t delta)
 {
-   Termcell *newcells;
+   Termsave_Row *row = TS_ROW_GET(ts->cells), *newrow;
+   int w = ts->w + delta;
 
-   newcells = realloc(ts->cells, (ts->w + delta) * sizeof(Termcell));
-   if (!newcells)
+   /* only plain rows end autowrapped */
+   EINA_SAFETY_ON_TRUE_RETURN_VAL(row->packed, NULL);
+
+   newrow = realloc(row, TS_ROW_SIZE(w * sizeof(Termcell)));
+   if (!newrow)
      return NULL;
-   newcells[ts->w - 1].att.autowrapped = 0;
-   memcpy(&newcells[ts->w], cells, delta * sizeof(Termcell));
-   ts->w += delta;
-   ts->cells = newcells;
+   newrow->key.data = (unsigned char *)newrow->cells;
+   newrow->key.size = w * sizeof(Termcell);
+   _mem_add(ty, delta * sizeof(Termcell));
+   newrow->cells[ts->w - 1].att.autowrapped = 0;
+   memcpy(&newrow->cells[ts->w], cells, delta * sizeof(Termcell));
+   ts->cells = newrow->cells;
+   ts->w = w;
+
+   /* the line is complete now */
+   if (_row_packable(newrow->cells, w))
+     {
+        row = _row_packed_get(ty, newrow->cells, w);
+        if (row)
+          {
+             _row_unref(ty, newrow);
+             ts->cells = row->cells;
+             ts->comp = 1;
+             if (!ts_compfreeze)
+               {
+                  ts_uncomp--;
+                  ts_comp++;
+               }
+          }
+     }
    return ts;
 }
 
 void
-termpty_save_free(Termsave *ts)
+termpty_save_free(Termpty *ty, Termsave *ts)
 {
-   if (!ts) return;
+   if ((!ts) || (!ts->cells)) return;
    if (!ts_compfreeze)
      {
         if (ts->comp) ts_comp--;
         else ts_uncomp--;
         ts_freeops++;
      }
-   _ts_free(ts->cells);
+   _row_unref(ty, TS_ROW_GET(ts->cells));
    ts->cells = NULL;
+   ts->comp = 0;
    ts->w = 0;
 }
 
+Termcell *
+termpty_save_cells_get(Termpty *ty, Termsave *ts)
+{
+   Termsave_Cache *cache;
+   const Termsave_Row *row;
+   int i;
+
+   if ((!ts->cells) || (!ts->comp)) return ts->cells;
+
+   row = TS_ROW_GET(ts->cells);
+   cache = _cache_get(ty);
+   if (!cache) return NULL;
+   for (i = 0; i < TS_CACHE_SLOTS; i++)
+     if (cache->slots[i].row == row)
+       return cache->slots[i].cells;
+
+   i = cache->next;
+   cache->next = (cache->next + 1) % TS_CACHE_SLOTS;
+   cache->slots[i].row = NULL;
+   if (cache->slots[i].w < (int)ts->w)
+     {
+        Termcell *cells;
+
+        cells = realloc(cache->slots[i].cells, ts->w * sizeof(Termcell));
+        if (!cells) return NULL;
+        cache->slots[i].cells = cells;
+        cache->slots[i].w = ts->w;
+     }
+   _row_unpack((const unsigned char *)row->cells, ts->w,
+               cache->slots[i].cells);
+   cache->slots[i].row = row;
+   return cache->slots[i].cells;
+}
+
+void
+termpty_save_dedup_stats_get(const Termpty *ty,
+                             unsigned long *lines, unsigned long *shared)
+{
+   if (lines) *lines = ty->backdedup.lines;
+   if (shared) *shared = ty->backdedup.hits;
+}
+
 void
-termpty_backlog_lock(void)
+termpty_save_cleanup(Termpty *ty)
+{
+   Termsave_Cache *cache = ty->backcache;
+
+   if (ty->backdedup.rows) eina_hash_free(ty->backdedup.rows);
+   ty->backdedup.rows = NULL;
+   if (cache)
+     {
+        int i;
+
+        for (i = 0; i < TS_CACHE_SLOTS; i++)
+          free(cache->slots[i].cells);
+        free(cache->pack);
+        free(cache);
+     }
+   ty->backcache = NULL;
+   _index_free(ty);
+   _summary_free(ty);
+}
+
+/* Search index
+ *
+ * When enabled, every row entering the backlog gets a sequence number
+ * and the trigrams of its folded text are hashed into TS_INDEX_BUCKETS
+ * buckets, each bucket being the sorted list of the rows that hold one
+ * of its trigrams.  A search for a needle of three codepoints or more
+ * intersects the buckets of its trigrams, which gives the only rows that
+ * may hold it; they still have to be checked since buckets are shared.
+ *
+ * Rows before idx->floor are not indexed and always have to be checked.
+ * The floor moves up as rows fall off the ring or get trimmed, and also
+ * when the index holds more than TS_INDEX_PER_ROW entries per backlog
+ * row, which bounds its memory.  That memory is counted in the backlog
+ * usage of the terminal, so it is part of the scrollback budget.
+ */
+
+#define TS_INDEX_BITS    13
+#define TS_INDEX_BUCKETS (1 << TS_INDEX_BITS)
+#define TS_INDEX_PER_ROW 64
+
+typedef struct _Termsave_Postings Termsave_Postings;
+
+struct _Termsave_Postings
+{
+   uint32_t    *seqs;
+   unsigned int n, size;
+};
+
+struct _Termsave_Index
+{
+   Termsave_Postings buckets[TS_INDEX_BUCKETS];
+   /* sequence number of the newest backlog row, the first one being 1 */
+   uint32_t          seq;
+   uint32_t          floor;
+   size_t            count;
+   unsigned char     enabled : 1;
+   unsigned char     full : 1;
+};
+
+struct _Termsave_Query
+{
+   uint32_t    *seqs;
+   unsigned int n;
+   uint32_t     floor, newest;
+};
+
+static inline Eina_Unicode
+_index_fold(Eina_Unicode g)
+{
+   if (g == 0) return ' ';
+   if (g < 0x80)
+     return ((g >= 'A') && (g <= 'Z')) ? g + ('a' - 'A') : g;
+   return towlower(g);
+}
+
+static inline Eina_Bool
+_index_filler(const Termcell *cells, int x)
+{
+#if defined(SUPPORT_DBLWIDTH)
+   return ((x > 0) && (cells[x].codepoint == 0) &&
+           (cells[x - 1].att.dblwidth) && (cells[x - 1].codepoint != 0));
+#else
+   (void)cells;
+   (void)x;
+   return EINA_FALSE;
+#endif
+}
+
+static inline unsigned int
+_index_bucket(Eina_Unicode g1, Eina_Unicode g2, Eina_Unicode g3)
+{
+   uint32_t h = (((uint32_t)g1 * 31) + g2) * 31 + g3;
+
+   return (h * 2654435761U) >> (32 - TS_INDEX_BITS);
+}
+
+static void
+_index_posting_add(Termpty *ty, Termsave_Index *idx, unsigned int b,
+                   uint32_t seq)
+{
+   Termsave_Postings *p = &idx->buckets[b];
+
+   if ((p->n > 0) && (p->seqs[p->n - 1] == seq)) return;
+   if (p->n == p->size)
+     {
+        uint32_t *tmp;
+        unsigned int size = p->size ? p->size * 2 : 4;
+
+        tmp = realloc(p->seqs, size * sizeof(uint32_t));
+        if (!tmp) return;
+        _mem_add(ty, (ssize_t)(size - p->size) * sizeof(uint32_t));
+        p->seqs = tmp;
+        p->size = size;
+     }
+   p->seqs[p->n++] = seq;
+   idx->count++;
+}
+
+/* indexes the trigrams of cells ending at or after cell from */
+static void
+_index_cells_add(Termpty *ty, Termsave_Index *idx, const Termcell *cells,
+                 int w, int from, uint32_t seq)
+{
+   Eina_Unicode g1 = 0, g2 = 0;
+   int x, n = 0;
+
+   for (x = 0; x < w; x++)
+     {
+        Eina_Unicode g;
+
+        if (_index_filler(cells, x)) continue;
+        g = _index_fold(cells[x].codepoint);
+        if ((++n >= 3) && (x >= from))
+          _index_posting_add(ty, idx, _index_bucket(g1, g2, g), seq);
+        g1 = g2;
+        g2 = g;
+     }
+}
+
+static unsigned int
+_index_seq_lower(const Termsave_Postings *p, uint32_t seq)
+{
+   unsigned int lo = 0, hi = p->n;
+
+   while (lo < hi)
+     {
+        unsigned int mid = (lo + hi) / 2;
+
+        if (p->seqs[mid] < seq) lo = mid + 1;
+        else hi = mid;
+     }
+   return lo;
+}
+
+static void
+_index_postings_free(Termpty *ty, Termsave_Index *idx)
+{
+   int b;
+
+   for (b = 0; b < TS_INDEX_BUCKETS; b++)
+     {
+        Termsave_Postings *p = &idx->buckets[b];
+
+        _mem_add(ty, -(ssize_t)(p->size * sizeof(uint32_t)));
+        free(p->seqs);
+        p->seqs = NULL;
+        p->n = p->size = 0;
+     }
+   idx->count = 0;
+}
+
+static void
+_index_free(Termpty *ty)
+{
+   if (!ty->backindex) return;
+   _index_postings_free(ty, ty->backindex);
+   _mem_add(ty, -(ssize_t)sizeof(Termsave_Index));
+   free(ty->backindex);
+   ty->backindex = NULL;
+}
+
+/* forgets about the rows before floor */
+static void
+_index_floor_set(Termpty *ty, uint32_t floor)
+{
+   Termsave_Index *idx = ty->backindex;
+   int b;
+
+   if ((!idx) || (floor <= idx->floor)) return;
+   idx->floor = floor;
+   if (!idx->count) return;
+   for (b = 0; b < TS_INDEX_BUCKETS; b++)
+     {
+        Termsave_Postings *p = &idx->buckets[b];
+        unsigned int i = _index_seq_lower(p, floor);
+
+        if (i == 0) continue;
+        memmove(p->seqs, p->seqs + i, (p->n - i) * sizeof(uint32_t));
+        p->n -= i;
+        idx->count -= i;
+        if ((p->size > 4) && (p->n < p->size / 4))
+          {
+             unsigned int size = p->n > 2 ? p->n * 2 : 4;
+             uint32_t *tmp = realloc(p->seqs, size * sizeof(uint32_t));
+
+             if (!tmp) continue;
+             _mem_add(ty, -(ssize_t)(p->size - size) * sizeof(uint32_t));
+             p->seqs = tmp;
+             p->size = size;
+          }
+     }
+}
+
+/* sequence number of backlog row y, 1 being the newest, 0 if it came
+ * before the index */
+static inline uint32_t
+_index_seq_get(const Termsave_Index *idx, int y)
+{
+   if ((y < 1) || ((uint32_t)(y - 1) >= idx->seq)) return 0;
+   return idx->seq - (uint32_t)(y - 1);
+}
+
+/* only backlog rows up to y, 1 being the newest, are left */
+static void
+_index_trim(Termpty *ty, int y)
+{
+   Termsave_Index *idx = ty->backindex;
+   uint32_t floor;
+
+   if (!idx) return;
+   if (y <= 0)
+     floor = idx->seq + 1;
+   else
+     {
+        floor = _index_seq_get(idx, y);
+        if (!floor) return;
+     }
+   _index_floor_set(ty, floor);
+}
+
+static void
+_index_bound(Termpty *ty, Termsave_Index *idx)
+{
+   uint32_t floor;
+
+   if (idx->count <= ty->backsize * TS_INDEX_PER_ROW) return;
+   /* rows that left the ring, and a quarter of the remaining ones */
+   floor = _index_seq_get(idx, ty->backsize);
+   if (floor < idx->floor) floor = idx->floor;
+   floor += (idx->seq - floor + 1) / 4 + 1;
+   _index_floor_set(ty, floor);
+}
+
+void
+termpty_save_index_set(Termpty *ty, Eina_Bool enabled)
+{
+   Termsave_Index *idx = ty->backindex;
+
+   if ((!idx) && (!enabled)) return;
+   if ((idx) && (!!idx->enabled == !!enabled)) return;
+   if (!enabled)
+     {
+        termpty_backlog_lock(ty);
+        _index_postings_free(ty, idx);
+        idx->enabled = EINA_FALSE;
+        termpty_backlog_unlock(ty);
+        return;
+     }
+   if (!idx)
+     {
+        idx = calloc(1, sizeof(Termsave_Index));
+        if (!idx) return;
+        ty->backindex = idx;
+        _mem_add(ty, sizeof(Termsave_Index));
+     }
+   termpty_backlog_lock(ty);
+   idx->floor = idx->seq + 1;
+   idx->enabled = !idx->full;
+   termpty_backlog_unlock(ty);
+}
+
+/* cells is the newest row of the backlog, just added */
+void
+termpty_save_index_add(Termpty *ty, const Termcell *cells, int w)
+{
+   Termsave_Index *idx = ty->backindex;
+
+   if (!idx) return;
+   termpty_backlog_lock_check(ty, __func__);
+   if (idx->seq == UINT32_MAX)
+     {
+        /* that is a lot of output, stop there */
+        _index_postings_free(ty, idx);
+        idx->enabled = EINA_FALSE;
+        idx->full = EINA_TRUE;
+        return;
+     }
+   idx->seq++;
+   if (!idx->enabled) return;
+   _index_cells_add(ty, idx, cells, w, 0, idx->seq);
+   _index_bound(ty, idx);
+}
+
+/* the newest row of the backlog, ts, was old_w cells wide before being
+ * expanded */
+void
+termpty_save_index_expand(Termpty *ty, Termsave *ts, int old_w)
+{
+   Termsave_Index *idx = ty->backindex;
+   const Termcell *cells;
+
+   if ((!idx) || (!idx->enabled) || (idx->seq < idx->floor)) return;
+   termpty_backlog_lock_check(ty, __func__);
+   cells = termpty_save_cells_get(ty, ts);
+   if (!cells) return;
+   _index_cells_add(ty, idx, cells, ts->w, old_w, idx->seq);
+   _index_bound(ty, idx);
+}
+
+/* the backlog got emptied */
+void
+termpty_save_index_reset(Termpty *ty)
+{
+   _index_trim(ty, 0);
+}
+
+static int
+_index_uint_cmp(const void *a, const void *b)
+{
+   unsigned int ua = *(const unsigned int *)a, ub = *(const unsigned int *)b;
+
+   return (ua > ub) - (ua < ub);
+}
+
+/* rows that may hold needle, once folded, or NULL if the index cannot
+ * tell */
+Termsave_Query *
+termpty_save_index_query(Termpty *ty, const Eina_Unicode *needle, int len)
+{
+   Termsave_Index *idx = ty->backindex;
+   Termsave_Query *q;
+   const Termsave_Postings *smallest = NULL;
+   unsigned int *buckets;
+   int i, n = 0;
+
+   if ((!idx) || (!idx->enabled) || (len < 3)) return NULL;
+   termpty_backlog_lock_check(ty, __func__);
+   buckets = malloc((len - 2) * sizeof(unsigned int));
+   if (!buckets) return NULL;
+   for (i = 2; i < len; i++)
+     buckets[n++] = _index_bucket(_index_fold(needle[i - 2]),
+                                  _index_fold(needle[i - 1]),
+                                  _index_fold(needle[i]));
+   qsort(buckets, n, sizeof(unsigned int), _index_uint_cmp);
+   for (i = 0; i < n; i++)
+     {
+        const Termsave_Postings *p = &idx->buckets[buckets[i]];
+
+        if ((!smallest) || (p->n < smallest->n)) smallest = p;
+     }
+
+   q = calloc(1, sizeof(Termsave_Query));
+   if (!q) goto end;
+   q->floor = idx->floor;
+   q->newest = idx->seq;
+   if (smallest->n > 0)
+     {
+        q->seqs = malloc(smallest->n * sizeof(uint32_t));
+        if (!q->seqs)
+          {
+             free(q);
+             q = NULL;
+             goto end;
+          }
+     }
+   for (i = 0; i < (int)smallest->n; i++)
+     {
+        uint32_t seq = smallest->seqs[i];
+        int j;
+
+        for (j = 0; j < n; j++)
+          {
+             const Termsave_Postings *p = &idx->buckets[buckets[j]];
+             unsigned int k;
+
+             if ((p == smallest) || ((j > 0) && (buckets[j] == buckets[j - 1])))
+               continue;
+             k = _index_seq_lower(p, seq);
+             if ((k >= p->n) || (p->seqs[k] != seq)) break;
+          }
+        if (j == n) q->seqs[q->n++] = seq;
+     }
+end:
+   free(buckets);
+   return q;
+}
+
+/* whether backlog row y, 1 being the newest, may hold what q was made
+ * for */
+Eina_Bool
+termpty_save_index_row_check(Termpty *ty, const Termsave_Query *q, int y)
+{
+   const Termsave_Index *idx = ty->backindex;
+   uint32_t seq;
+   unsigned int lo, hi;
+
+   if ((!q) || (!idx)) return EINA_TRUE;
+   seq = _index_seq_get(idx, y);
+   /* not indexed, or still growing when the query was made */
+   if ((seq < q->floor) || (seq >= q->newest)) return EINA_TRUE;
+   lo = 0;
+   hi = q->n;
+   while (lo < hi)
+     {
+        unsigned int mid = (lo + hi) / 2;
+
+        if (q->seqs[mid] < seq) lo = mid + 1;
+        else hi = mid;
+     }
+   return ((lo < q->n) && (q->seqs[lo] == seq));
+}
+
+void
+termpty_save_index_query_free(Termsave_Query *q)
+{
+   if (!q) return;
+   free(q->seqs);
+   free(q);
+}
+
+/* History summary
+ *
+ * For the miniview to show the whole backlog at once, every row entering
+ * the backlog is reduced to TERMSAVE_SUMMARY_W pixels, each being 1 + the
+ * palette entry the miniview shows for the cell, or 0 for nothing.  Cells
+ * past TERMSAVE_SUMMARY_W are folded onto the first ones.  Level 0 holds
+ * one summary row for TERMSAVE_SUMMARY_RATIO backlog rows, level 1 one for
+ * TERMSAVE_SUMMARY_RATIO rows of level 0 and so on, each pixel being the
+ * one most found among the rows merged, empty ones aside.
+ *
+ * The rows of a level waiting to be merged are kept apart until one more
+ * comes, so that the newest backlog row can still grow.  Every level is a
+ * ring long enough for the backlog ring, so old rows go as they go from
+ * the backlog.  It is only built once asked for, and its memory is
+ * counted in the backlog usage of the terminal like the search index.
+ */
+
+typedef struct _Termsave_Summary_Level Termsave_Summary_Level;
+
+struct _Termsave_Summary_Level
+{
+   unsigned short *rows;
+   unsigned int    size, pos, n;
+   /* rows of the level below, or of the backlog, not merged yet */
+   unsigned short  pending[TERMSAVE_SUMMARY_RATIO][TERMSAVE_SUMMARY_W];
+   unsigned int    npending;
+};
+
+struct _Termsave_Summary
+{
+   /* colors_generation_get() when it got built */
+   unsigned int colors_gen;
+   Termsave_Summary_Level levels[TERMSAVE_SUMMARY_LEVELS];
+};
+
+/* out gets the pixel most found in every column of the n rows */
+static void
+_summary_merge(const unsigned short **rows, int n, unsigned short *out)
+{
+   int x, i, j;
+
+   for (x = 0; x < TERMSAVE_SUMMARY_W; x++)
+     {
+        unsigned short best = 0;
+        int best_count = 0;
+
+        for (i = 0; i < n; i++)
+          {
+             unsigned short v = rows[i][x];
+             int count = 1;
+
+             if ((!v) || (v == best)) continue;
+             for (j = i + 1; j < n; j++)
+               if (rows[j][x] == v) count++;
+             if (count > best_count)
+               {
+                  best = v;
+                  best_count = count;
+               }
+          }
+        out[x] = best;
+     }
+}
+
+static void
+_summary_cells(const Termcell *cells, int w, unsigned short *out)
+{
+   Color_Pair col[TERMSAVE_SUMMARY_W];
+   int off;
+
+   memset(out, 0, TERMSAVE_SUMMARY_W * sizeof(unsigned short));
+   for (off = 0; off < w; off += TERMSAVE_SUMMARY_W)
+     {
+        int n = w - off, x;
+
+        if (n > TERMSAVE_SUMMARY_W) n = TERMSAVE_SUMMARY_W;
+        colors_row_get(cells + off, n, EINA_FALSE, col);
+        for (x = 0; x < n; x++)
+          {
+             int c;
+
+             if (out[x]) continue;
+             c = colors_cell_minimap_get(&cells[off + x], &col[x]);
+             if (c >= 0) out[x] = c + 1;
+          }
+     }
+}
+
+static void
+_summary_free(Termpty *ty)
+{
+   Termsave_Summary *sum = ty->backsummary;
+   ssize_t bytes = sizeof(Termsave_Summary);
+   int l;
+
+   if (!sum) return;
+   for (l = 0; l < TERMSAVE_SUMMARY_LEVELS; l++)
+     {
+        bytes += (ssize_t)sum->levels[l].size
+                 * TERMSAVE_SUMMARY_W * sizeof(unsigned short);
+        free(sum->levels[l].rows);
+     }
+   free(sum);
+   ty->backsummary = NULL;
+   _mem_add(ty, -bytes);
+}
+
+/* makes every level as long as the backlog needs, emptying them */
+static Eina_Bool
+_summary_alloc(Termpty *ty, Termsave_Summary *sum)
+{
+   size_t per_row = TERMSAVE_SUMMARY_RATIO;
+   ssize_t bytes = 0;
+   int l;
+
+   for (l = 0; l < TERMSAVE_SUMMARY_LEVELS; l++)
+     {
+        Termsave_Summary_Level *lv = &sum->levels[l];
+        unsigned int size = (ty->backsize / per_row) + 2;
+
+        if (size != lv->size)
+          {
+             unsigned short *rows;
+
+             rows = realloc(lv->rows, (size_t)size * TERMSAVE_SUMMARY_W
+                            * sizeof(unsigned short));
+             if (!rows) return EINA_FALSE;
+             bytes += ((ssize_t)size - lv->size)
+                      * TERMSAVE_SUMMARY_W * sizeof(unsigned short);
+             lv->rows = rows;
+             lv->size = size;
+          }
+        lv->pos = lv->n = lv->npending = 0;
+        per_row *= TERMSAVE_SUMMARY_RATIO;
+     }
+   _mem_add(ty, bytes);
+   return EINA_TRUE;
+}
+
+/* row is one more row for level l to merge */
+static void
+_summary_level_add(Termsave_Summary *sum, int l, const unsigned short *row)
+{
+   Termsave_Summary_Level *lv = &sum->levels[l];
+
+   if (lv->npending == TERMSAVE_SUMMARY_RATIO)
+     {
+        const unsigned short *rows[TERMSAVE_SUMMARY_RATIO];
+        unsigned short *out = lv->rows + (size_t)lv->pos * TERMSAVE_SUMMARY_W;
+        unsigned int i;
+
+        for (i = 0; i < lv->npending; i++)
+          rows[i] = lv->pending[i];
+        _summary_merge(rows, lv->npending, out);
+        lv->pos = (lv->pos + 1) % lv->size;
+        if (lv->n < lv->size) lv->n++;
+        lv->npending = 0;
+        if (l + 1 < TERMSAVE_SUMMARY_LEVELS)
+          _summary_level_add(sum, l + 1, out);
+     }
+   memcpy(lv->pending[lv->npending++], row,
+          TERMSAVE_SUMMARY_W * sizeof(unsigned short));
+}
+
+/* the row of level l made of everything after its ring, FALSE if none */
+static Eina_Bool
+_summary_partial(const Termsave_Summary *sum, int l, unsigned short *out)
+{
+   const Termsave_Summary_Level *lv = &sum->levels[l];
+   const unsigned short *rows[TERMSAVE_SUMMARY_RATIO + 1];
+   unsigned short below[TERMSAVE_SUMMARY_W];
+   unsigned int i, n = 0;
+
+   for (i = 0; i < lv->npending; i++)
+     rows[n++] = lv->pending[i];
+   if ((l > 0) && (_summary_partial(sum, l - 1, below)))
+     rows[n++] = below;
+   if (!n) return EINA_FALSE;
+   _summary_merge(rows, n, out);
+   return EINA_TRUE;
+}
+
+/* only backlog rows up to y, 1 being the newest, are left */
+static void
+_summary_trim(Termpty *ty, int y)
+{
+   Termsave_Summary *sum = ty->backsummary;
+   unsigned int per_row = TERMSAVE_SUMMARY_RATIO;
+   int l;
+
+   if (!sum) return;
+   for (l = 0; l < TERMSAVE_SUMMARY_LEVELS; l++)
+     {
+        Termsave_Summary_Level *lv = &sum->levels[l];
+
+        if (y <= 0)
+          lv->n = lv->npending = 0;
+        else if (lv->n > (unsigned int)y / per_row)
+          lv->n = (unsigned int)y / per_row;
+        per_row *= TERMSAVE_SUMMARY_RATIO;
+     }
+}
+
+/* starts summarizing the backlog of ty, beginning with what it holds, or
+ * summarizes it again if the palette changed since */
+void
+termpty_save_summary_set(Termpty *ty)
+{
+   Termsave_Summary *sum = ty->backsummary;
+   size_t y;
+
+   if ((sum) && (sum->colors_gen == colors_generation_get())) return;
+   if (!sum)
+     {
+        sum = calloc(1, sizeof(Termsave_Summary));
+        if (!sum) return;
+     }
+   termpty_backlog_lock(ty);
+   if (!ty->backsummary)
+     {
+        ty->backsummary = sum;
+        _mem_add(ty, sizeof(Termsave_Summary));
+     }
+   sum->colors_gen = colors_generation_get();
+   if (!_summary_alloc(ty, sum))
+     {
+        _summary_free(ty);
+        termpty_backlog_unlock(ty);
+        return;
+     }
+   for (y = ty->backsize; y > 0; y--)
+     {
+        Termsave *ts = &ty->back[(ty->backpos + 1 + ty->backsize - y)
+                                 % ty->backsize];
+        Termcell *cells;
+
+        if (!ts->cells) continue;
+        cells = termpty_save_cells_get(ty, ts);
+        if (cells) termpty_save_summary_add(ty, cells, ts->w);
+        /* trimmed to make room for the summary */
+        if (!ty->backsummary) break;
+     }
+   termpty_backlog_unlock(ty);
+}
+
+/* cells is the newest row of the backlog, just added */
+void
+termpty_save_summary_add(Termpty *ty, const Termcell *cells, int w)
+{
+   unsigned short row[TERMSAVE_SUMMARY_W];
+
+   if (!ty->backsummary) return;
+   termpty_backlog_lock_check(ty, __func__);
+   _summary_cells(cells, w, row);
+   _summary_level_add(ty->backsummary, 0, row);
+}
+
+/* the newest row of the backlog, ts, got expanded */
+void
+termpty_save_summary_expand(Termpty *ty, Termsave *ts)
+{
+   Termsave_Summary_Level *lv;
+   const Termcell *cells;
+
+   if (!ty->backsummary) return;
+   termpty_backlog_lock_check(ty, __func__);
+   lv = &ty->backsummary->levels[0];
+   if (!lv->npending) return;
+   cells = termpty_save_cells_get(ty, ts);
+   if (!cells) return;
+   _summary_cells(cells, ts->w, lv->pending[lv->npending - 1]);
+}
+
+/* the backlog got emptied, or its size changed */
+void
+termpty_save_summary_reset(Termpty *ty)
+{
+   if (!ty->backsummary) return;
+   termpty_backlog_lock_check(ty, __func__);
+   if (!_summary_alloc(ty, ty->backsummary))
+     _summary_free(ty);
+}
+
+/* number of rows of level, the oldest first, or 0 if there is no
+ * summary */
+int
+termpty_save_summary_rows(Termpty *ty, int level)
+{
+   const Termsave_Summary *sum = ty->backsummary;
+   const Termsave_Summary_Level *lv;
+   int l;
+
+   if ((!sum) || (level < 0) || (level >= TERMSAVE_SUMMARY_LEVELS))
+     return 0;
+   termpty_backlog_lock_check(ty, __func__);
+   lv = &sum->levels[level];
+   for (l = level; l >= 0; l--)
+     if (sum->levels[l].npending) return lv->n + 1;
+   return lv->n;
+}
+
+/* out gets the TERMSAVE_SUMMARY_W pixels of row i of level */
+Eina_Bool
+termpty_save_summary_row_get(Termpty *ty, int level, int i,
+                             unsigned short *out)
+{
+   const Termsave_Summary *sum = ty->backsummary;
+   const Termsave_Summary_Level *lv;
+
+   if ((!sum) || (level < 0) || (level >= TERMSAVE_SUMMARY_LEVELS) ||
+       (i < 0))
+     return EINA_FALSE;
+   termpty_backlog_lock_check(ty, __func__);
+   lv = &sum->levels[level];
+   if ((unsigned int)i < lv->n)
+     {
+        unsigned int slot = (lv->pos + lv->size - lv->n + i) % lv->size;
+
+        memcpy(out, lv->rows + (size_t)slot * TERMSAVE_SUMMARY_W,
+               TERMSAVE_SUMMARY_W * sizeof(unsigned short));
+        return EINA_TRUE;
+     }
+   if ((unsigned int)i > lv->n) return EINA_FALSE;
+   return _summary_partial(sum, level, out);
+}
+
+/* Snapshot files
+ *
+ * A snapshot is a header, the title, the backlog rows from the oldest to
+ * the newest and then the h rows of the main screen.  Every row is a
+ * Termsnap_Row followed by its cells, LZ4 compressed unless compression
+ * did not make them smaller (then len is exactly w * sizeof(Termcell)).
+ * Cells are dumped as they are in memory, so the header records
+ * sizeof(Termcell) and snapshots from a different layout are refused.
+ */
+
+#define TS_SNAP_MAGIC "TYSNAP\0\0"
+#define TS_SNAP_VERSION 1
+
+#define TS_SNAP_MODE_REVERSE     (1 << 0)
+#define TS_SNAP_MODE_APPCURSOR   (1 << 1)
+#define TS_SNAP_MODE_WRAP        (1 << 2)
+#define TS_SNAP_MODE_INSERT      (1 << 3)
+#define TS_SNAP_MODE_CRLF        (1 << 4)
+#define TS_SNAP_MODE_HIDE_CURSOR (1 << 5)
+#define TS_SNAP_MODE_ALTBUF      (1 << 6)
+
+typedef struct _Termsnap_Header Termsnap_Header;
+typedef struct _Termsnap_Row Termsnap_Row;
+
+struct _Termsnap_Header
+{
+   char     magic[8];
+   uint32_t version;
+   uint32_t cell_size;
+   int32_t  w, h;
+   int32_t  cx, cy;
+   uint32_t modes;
+   uint32_t title_len;
+   uint32_t backlog_rows;
+   uint32_t __pad;
+};
+
+struct _Termsnap_Row
+{
+   uint32_t w;
+   uint32_t len;
+};
+
+/* blocks belong to the terminal that got the media escapes, a snapshot
+ * only keeps blanks where they were */
+static void
+_snap_row_unblock(Termcell *cells, int w)
+{
+   int i;
+
+   for (i = 0; i < w; i++)
+     if (cells[i].codepoint & 0x80000000) cells[i].codepoint = 0;
+}
+
+static Eina_Bool
+_snap_row_write(FILE *f, const Termcell *cells, int w, char *buf)
+{
+   Termsnap_Row row;
+   Termcell *copy = NULL;
+   int size = w * sizeof(Termcell);
+   int len = 0;
+   Eina_Bool ok;
+
+   if (_row_has_blocks(cells, w))
+     {
+        copy = malloc(size);
+        if (!copy) return EINA_FALSE;
+        memcpy(copy, cells, size);
+        _snap_row_unblock(copy, w);
+        cells = copy;
+     }
+   row.w = w;
+   if (size > 0)
+     len = LZ4_compress((const char *)cells, buf, size);
+   if ((len <= 0) || (len >= size))
+     {
+        row.len = size;
+        ok = ((fwrite(&row, sizeof(row), 1, f) == 1) &&
+              ((size == 0) || (fwrite(cells, size, 1, f) == 1)));
+     }
+   else
+     {
+        row.len = len;
+        ok = ((fwrite(&row, sizeof(row), 1, f) == 1) &&
+              (fwrite(buf, len, 1, f) == 1));
+     }
+   free(copy);
+   return ok;
+}
+
+Eina_Bool
+termpty_save_snapshot_write(Termpty *ty, const char *path)
+{
+   Termsnap_Header hdr;
+   Termcell *screen;
+   FILE *f;
+   char *buf;
+   size_t y, nrows = 0;
+   int circular_offset, max_w;
+   Eina_Bool ok = EINA_TRUE;
+
+   EINA_SAFETY_ON_NULL_RETURN_VAL(ty, EINA_FALSE);
+   EINA_SAFETY_ON_NULL_RETURN_VAL(path, EINA_FALSE);
+
+   termpty_backlog_lock(ty);
+   /* always save the main screen, not the alternate one */
+   if (ty->altbuf)
+     {
+        screen = ty->screen2;
+        circular_offset = ty->circular_offset2;
+     }
+   else
+     {
+        screen = ty->screen;
+        circular_offset = ty->circular_offset;
+     }
+   max_w = ty->w;
+   for (y = 1; y <= ty->backsize; y++)
+     {
+        Termsave *ts = &ty->back[(ty->backpos + 1 + ty->backsize - y)
+                                 % ty->backsize];
+        if (!ts->cells) break;
+        if ((int)ts->w > max_w) max_w = ts->w;
+        nrows++;
+     }
+
+   buf = malloc(LZ4_compressBound(max_w * sizeof(Termcell)));
+   if (!buf)
+     {
+        termpty_backlog_unlock(ty);
+        return EINA_FALSE;
+     }
+   f = fopen(path, "wb");
+   if (!f)
+     {
+        ERR("could not open snapshot '%s': %s", path, strerror(errno));
+        termpty_backlog_unlock(ty);
+        free(buf);
+        return EINA_FALSE;
+     }
+
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, TS_SNAP_MAGIC, sizeof(hdr.magic));
+   hdr.version = TS_SNAP_VERSION;
+   hdr.cell_size = sizeof(Termcell);
+   hdr.w = ty->w;
+   hdr.h = ty->h;
+   hdr.cx = ty->cursor_state.cx;
+   hdr.cy = ty->cursor_state.cy;
+   if (ty->termstate.reverse) hdr.modes |= TS_SNAP_MODE_REVERSE;
+   if (ty->termstate.appcursor) hdr.modes |= TS_SNAP_MODE_APPCURSOR;
+   if (ty->termstate.wrap) hdr.modes |= TS_SNAP_MODE_WRAP;
+   if (ty->termstate.insert) hdr.modes |= TS_SNAP_MODE_INSERT;
+   if (ty->termstate.crlf) hdr.modes |= TS_SNAP_MODE_CRLF;
+   if (ty->termstate.hide_cursor) hdr.modes |= TS_SNAP_MODE_HIDE_CURSOR;
+   if (ty->altbuf) hdr.modes |= TS_SNAP_MODE_ALTBUF;
+   hdr.title_len = ty->prop.title ? strlen(ty->prop.title) : 0;
+   hdr.backlog_rows = nrows;
+
+   if (fwrite(&hdr, sizeof(hdr), 1, f) != 1)
+     ok = EINA_FALSE;
+   if (ok && hdr.title_len &&
+       (fwrite(ty->prop.title, hdr.title_len, 1, f) != 1))
+     ok = EINA_FALSE;
+   for (y = nrows; ok && (y > 0); y--)
+     {
+        Termsave *ts = &ty->back[(ty->backpos + 1 + ty->backsize - y)
+                                 % ty->backsize];
+        Termcell *cells = termpty_save_cells_get(ty, ts);
+
+        ok = (cells) && _snap_row_write(f, cells, ts->w, buf);
+     }
+   for (y = 0; ok && ((int)y < ty->h); y++)
+     {
+        Termcell *cells;
+
+        cells = &screen[((y + circular_offset) % ty->h) * ty->w];
+        ok = _snap_row_write(f, cells, ty->w, buf);
+     }
+   termpty_backlog_unlock(ty);
+
+   free(buf);
+   if (fclose(f) != 0) ok = EINA_FALSE;
+   if (!ok)
+     {
+        ERR("could not write snapshot '%s'", path);
+        unlink(path);
+     }
+   return ok;
+}
+
+/* reads and decompresses the next row of a snapshot into *buf, growing
+ * it and *zbuf, that holds the compressed row, as needed.  Returns
+ * EINA_FALSE if the file is truncated or corrupted */
+static Eina_Bool
+_snap_row_read(FILE *f, Termcell **buf, int *buf_w,
+               char **zbuf, int *zbuf_size, int *w)
+{
+   Termsnap_Row row;
+   int size;
+
+   if (fread(&row, sizeof(row), 1, f) != 1) return EINA_FALSE;
+   /* Termsave.w is 22 bits wide */
+   if (row.w >= (1 << 22)) return EINA_FALSE;
+   size = row.w * sizeof(Termcell);
+   if ((row.len != (uint32_t)size) &&
+       (row.len > (uint32_t)LZ4_compressBound(size)))
+     return EINA_FALSE;
+   if ((int)row.w > *buf_w)
+     {
+        Termcell *cells = realloc(*buf, row.w * sizeof(Termcell));
+
+        if (!cells) return EINA_FALSE;
+        *buf = cells;
+        *buf_w = row.w;
+     }
+   if ((int)row.len == size)
+     {
+        if ((size > 0) && (fread(*buf, size, 1, f) != 1))
+          return EINA_FALSE;
+     }
+   else
+     {
+        if ((int)row.len > *zbuf_size)
+          {
+             char *tmp = realloc(*zbuf, row.len);
+
+             if (!tmp) return EINA_FALSE;
+             *zbuf = tmp;
+             *zbuf_size = row.len;
+          }
+        if ((fread(*zbuf, row.len, 1, f) != 1) ||
+            (LZ4_decompress_safe(*zbuf, (char *)*buf, row.len, size) != size))
+          return EINA_FALSE;
+     }
+   *w = row.w;
+   /* older snapshots saved them as they were */
+   _snap_row_unblock(*buf, row.w);
+   return EINA_TRUE;
+}
+
+/* Every row is decompressed and added to the backlog as if it had just
+ * scrolled off, so restoring costs about as much as the rows would to
+ * print, short of parsing escapes */
+Eina_Bool
+termpty_save_snapshot_read(Termpty *ty, const char *path)
+{
+   Termsnap_Header hdr;
+   struct stat st;
+   FILE *f;
+   Termcell *cells = NULL;
+   char *zbuf = NULL, *title = NULL;
+   uint32_t i, skip = 0;
+   int y, w, off, cells_w = 0, zbuf_size = 0;
+   Eina_Bool ok = EINA_FALSE;
+
+   EINA_SAFETY_ON_NULL_RETURN_VAL(ty, EINA_FALSE);
+   EINA_SAFETY_ON_NULL_RETURN_VAL(path, EINA_FALSE);
+
+   f = fopen(path, "rb");
+   if (!f)
+     {
+        ERR("could not open snapshot '%s': %s", path, strerror(errno));
+        return EINA_FALSE;
+     }
+   if ((fstat(fileno(f), &st) != 0) ||
+       (fread(&hdr, sizeof(hdr), 1, f) != 1) ||
+       (memcmp(hdr.magic, TS_SNAP_MAGIC, sizeof(hdr.magic)) != 0) ||
+       (hdr.version != TS_SNAP_VERSION) ||
+       (hdr.cell_size != sizeof(Termcell)) ||
+       (hdr.w <= 0) || (hdr.h <= 0) ||
+       (st.st_size - (off_t)sizeof(hdr) < (off_t)hdr.title_len))
+     {
+        ERR("'%s' is not a snapshot this terminology can read", path);
+        goto end;
+     }
+   if (hdr.title_len > 0)
+     {
+        title = malloc(hdr.title_len);
+        if ((!title) || (fread(title, hdr.title_len, 1, f) != 1))
+          {
+             ERR("snapshot '%s' is truncated", path);
+             goto end;
+          }
+        eina_stringshare_del(ty->prop.title);
+        ty->prop.title = eina_stringshare_add_length(title, hdr.title_len);
+     }
+
+   termpty_backlog_lock(ty);
+   if (hdr.backlog_rows > ty->backsize)
+     skip = hdr.backlog_rows - ty->backsize;
+   for (i = 0; i < hdr.backlog_rows; i++)
+     {
+        Termsave *ts;
+
+        if (!_snap_row_read(f, &cells, &cells_w, &zbuf, &zbuf_size, &w))
+          goto truncated;
+        if ((i < skip) || (!ty->backsize)) continue;
+        ts = &ty->back[(ty->backpos + 1) % ty->backsize];
+        if (!termpty_save_add(ty, ts, cells, w)) continue;
+        termpty_save_index_add(ty, cells, w);
+        termpty_save_summary_add(ty, cells, w);
+        ty->backpos++;
+        if (ty->backpos >= ty->backsize)
+          ty->backpos = 0;
+        ty->backlog_pushed += (w > ty->w) ? (w + ty->w - 1) / ty->w : 1;
+     }
+   ty->backlog_beacon.screen_y = 0;
+   ty->backlog_beacon.backlog_y = 0;
+
+   /* rows that do not fit on the current screen go to the backlog */
+   off = (hdr.h > ty->h) ? hdr.h - ty->h : 0;
+   for (y = 0; y < hdr.h; y++)
+     {
+        if (!_snap_row_read(f, &cells, &cells_w, &zbuf, &zbuf_size, &w))
+          goto truncated;
+        if (y < off)
+          {
+             termpty_text_save_top(ty, cells, w);
+             continue;
+          }
+        if (w > ty->w) w = ty->w;
+        termpty_cells_clear(ty, &(TERMPTY_SCREEN(ty, 0, y - off)), ty->w);
+        termpty_cell_copy(ty, cells, &(TERMPTY_SCREEN(ty, 0, y - off)), w);
+     }
+   termpty_backlog_unlock(ty);
+
+   ty->cursor_state.cx = hdr.cx;
+   ty->cursor_state.cy = hdr.cy - off;
+   TERMPTY_RESTRICT_FIELD(ty->cursor_state.cx, 0, ty->w);
+   TERMPTY_RESTRICT_FIELD(ty->cursor_state.cy, 0, ty->h);
+   /* the program that set the input modes is gone, only restore what
+    * affects the display */
+   ty->termstate.reverse = !!(hdr.modes & TS_SNAP_MODE_REVERSE);
+   if ((hdr.title_len > 0) && (ty->cb.set_title.func))
+     ty->cb.set_title.func(ty->cb.set_title.data);
+   ok = EINA_TRUE;
+   goto end;
+
+truncated:
+   termpty_backlog_unlock(ty);
+   ERR("snapshot '%s' is truncated", path);
+end:
+   free(title);
+   free(zbuf);
+   free(cells);
+   fclose(f);
+   return ok;
+}
+
+/* Backlog locking
+ *
+ * termpty_backlog_lock() must be held by anything reading or changing
+ * ty->back, ty->screen or ty->screen2 outside of the escape handling
+ * that fills them.  It is a plain mutex that can be taken again by the
+ * thread that already holds it, as resizing or resetting a terminal
+ * ends up saving lines to the backlog.  Readers copy what they need
+ * while holding it and must not keep pointers to cells after
+ * unlocking: rows are reallocated in place when lines get joined.
+ *
+ * owner is only ever the thread holding the lock, or BACKLOCK_NO_OWNER:
+ * the holder resets it before releasing the lock, so that a thread
+ * reading it unlocked can only find itself when it holds the lock.
+ * depth is only used by the holder.
+ */
+
+/* not a thread, and what a new Termpty has from calloc() */
+#define BACKLOCK_NO_OWNER ((Eina_Thread)0)
+
+void
+termpty_backlog_lock(Termpty *ty)
+{
+   Eina_Thread self = eina_thread_self();
+
+   if (eina_thread_equal(ty->backlock.owner, self))
+     {
+        ty->backlock.depth++;
+        return;
+     }
+   eina_lock_take(&ty->backlock.lock);
+   ty->backlock.owner = self;
+   ty->backlock.depth = 1;
+}
+
+void
+termpty_backlog_unlock(Termpty *ty)
+{
+   if (!eina_thread_equal(ty->backlock.owner, eina_thread_self()))
+     {
+        ERR("unlocking the backlog of %p that is not locked by this thread",
+            ty);
+        return;
+     }
+   ty->backlock.depth--;
+   if (ty->backlock.depth == 0)
+     {
+        ty->backlock.owner = BACKLOCK_NO_OWNER;
+        eina_lock_release(&ty->backlock.lock);
+     }
+}
+
+Eina_Bool
+termpty_backlog_locked(const Termpty *ty)
 {
+   return eina_thread_equal(ty->backlock.owner, eina_thread_self());
 }
 
 void
-termpty_backlog_unlock(void)
+termpty_backlog_lock_check(const Termpty *ty, const char *func)
 {
+   if (!termpty_backlog_locked(ty))
+     ERR("%s() accessed the backlog of %p without locking it", func, ty);
 }
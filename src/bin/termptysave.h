@@ -1,11 +1,45 @@
 #ifndef _TERMPTY_SAVE_H__
 #define _TERMPTY_SAVE_H__ 1
 
+typedef struct _Termsave_Query Termsave_Query;
+
+/* see termpty_save_summary_row_get() */
+#define TERMSAVE_SUMMARY_W      128
+#define TERMSAVE_SUMMARY_RATIO  8
+#define TERMSAVE_SUMMARY_LEVELS 6
+
 void termpty_save_register(Termpty *ty);
 void termpty_save_unregister(Termpty *ty);
 Termsave *termpty_save_extract(Termsave *ts);
-Termsave *termpty_save_new(Termsave *ts, int w);
-void termpty_save_free(Termsave *ts);
-Termsave *termpty_save_expand(Termsave *ts, Termcell *cells, size_t delta);
+Termsave *termpty_save_new(Termpty *ty, Termsave *ts, int w);
+Termsave *termpty_save_add(Termpty *ty, Termsave *ts, Termcell *cells, int w);
+void termpty_save_free(Termpty *ty, Termsave *ts);
+Termsave *termpty_save_expand(Termpty *ty, Termsave *ts, Termcell *cells, size_t delta);
+Termcell *termpty_save_cells_get(Termpty *ty, Termsave *ts);
+void termpty_save_cleanup(Termpty *ty);
+
+void termpty_save_budget_set(size_t bytes);
+void termpty_save_focus_set(Termpty *ty);
+size_t termpty_save_usage_get(const Termpty *ty);
+size_t termpty_save_total_usage_get(void);
+void termpty_save_dedup_stats_get(const Termpty *ty, unsigned long *lines, unsigned long *shared);
+
+void termpty_save_index_set(Termpty *ty, Eina_Bool enabled);
+void termpty_save_index_add(Termpty *ty, const Termcell *cells, int w);
+void termpty_save_index_expand(Termpty *ty, Termsave *ts, int old_w);
+void termpty_save_index_reset(Termpty *ty);
+Termsave_Query *termpty_save_index_query(Termpty *ty, const Eina_Unicode *needle, int len);
+Eina_Bool termpty_save_index_row_check(Termpty *ty, const Termsave_Query *q, int y);
+void termpty_save_index_query_free(Termsave_Query *q);
+
+void termpty_save_summary_set(Termpty *ty);
+void termpty_save_summary_add(Termpty *ty, const Termcell *cells, int w);
+void termpty_save_summary_expand(Termpty *ty, Termsave *ts);
+void termpty_save_summary_reset(Termpty *ty);
+int termpty_save_summary_rows(Termpty *ty, int level);
+Eina_Bool termpty_save_summary_row_get(Termpty *ty, int level, int i, unsigned short *out);
+
+Eina_Bool termpty_save_snapshot_write(Termpty *ty, const char *path);
+Eina_Bool termpty_save_snapshot_read(Termpty *ty, const char *path);
 
 #endif
@@ -1303,3 +1303,211 @@ static const Tty_Key tty_keys_kp_app[] = {
 },
 };
 #undef KH
+static int
+tty_keys_index(const char *key, int len)
+{
+   switch (len)
+     {
+      case 2:
+        switch (key[1])
+          {
+           case '1':
+             if (!memcmp(key, "F1", 2)) return 0;
+             return -1;
+           case '2':
+             if (!memcmp(key, "F2", 2)) return 1;
+             return -1;
+           case '3':
+             if (!memcmp(key, "F3", 2)) return 2;
+             return -1;
+           case '4':
+             if (!memcmp(key, "F4", 2)) return 3;
+             return -1;
+           case '5':
+             if (!memcmp(key, "F5", 2)) return 4;
+             return -1;
+           case '6':
+             if (!memcmp(key, "F6", 2)) return 5;
+             return -1;
+           case '7':
+             if (!memcmp(key, "F7", 2)) return 6;
+             return -1;
+           case '8':
+             if (!memcmp(key, "F8", 2)) return 7;
+             return -1;
+           case '9':
+             if (!memcmp(key, "F9", 2)) return 8;
+             return -1;
+           case 'p':
+             if (!memcmp(key, "Up", 2)) return 14;
+             return -1;
+          }
+        return -1;
+      case 3:
+        switch (key[2])
+          {
+           case '0':
+             if (!memcmp(key, "F10", 3)) return 9;
+             return -1;
+           case '1':
+             if (!memcmp(key, "F11", 3)) return 10;
+             return -1;
+           case '2':
+             if (!memcmp(key, "F12", 3)) return 11;
+             return -1;
+           case 'd':
+             if (!memcmp(key, "End", 3)) return 17;
+             return -1;
+           case 'b':
+             if (!memcmp(key, "Tab", 3)) return 23;
+             return -1;
+          }
+        return -1;
+      case 4:
+        switch (key[0])
+          {
+           case 'L':
+             if (!memcmp(key, "Left", 4)) return 12;
+             return -1;
+           case 'D':
+             if (!memcmp(key, "Down", 4)) return 15;
+             return -1;
+           case 'H':
+             if (!memcmp(key, "Home", 4)) return 16;
+             if (!memcmp(key, "Help", 4)) return 29;
+             return -1;
+           case 'N':
+             if (!memcmp(key, "Next", 4)) return 21;
+             return -1;
+           case 'M':
+             if (!memcmp(key, "Menu", 4)) return 27;
+             return -1;
+           case 'F':
+             if (!memcmp(key, "Find", 4)) return 28;
+             return -1;
+          }
+        return -1;
+      case 5:
+        switch (key[0])
+          {
+           case 'R':
+             if (!memcmp(key, "Right", 5)) return 13;
+             return -1;
+           case 'P':
+             if (!memcmp(key, "Prior", 5)) return 20;
+             return -1;
+           case 'm':
+             if (!memcmp(key, "minus", 5)) return 24;
+             return -1;
+           case 's':
+             if (!memcmp(key, "space", 5)) return 26;
+             return -1;
+          }
+        return -1;
+      case 6:
+        switch (key[0])
+          {
+           case 'I':
+             if (!memcmp(key, "Insert", 6)) return 18;
+             return -1;
+           case 'D':
+             if (!memcmp(key, "Delete", 6)) return 19;
+             return -1;
+           case 'S':
+             if (!memcmp(key, "Select", 6)) return 31;
+             return -1;
+          }
+        return -1;
+      case 7:
+        switch (key[0])
+          {
+           case 'E':
+             if (!memcmp(key, "Execute", 7)) return 30;
+             return -1;
+          }
+        return -1;
+      case 10:
+        switch (key[0])
+          {
+           case 'u':
+             if (!memcmp(key, "underscore", 10)) return 25;
+             return -1;
+          }
+        return -1;
+      case 12:
+        switch (key[0])
+          {
+           case 'I':
+             if (!memcmp(key, "ISO_Left_Tab", 12)) return 22;
+             return -1;
+          }
+        return -1;
+     }
+   return -1;
+}
+static int
+tty_keys_kp_index(const char *key, int len)
+{
+   switch (len)
+     {
+      case 5:
+        switch (key[0])
+          {
+           case 'K':
+             if (!memcmp(key, "KP_Up", 5)) return 0;
+             return -1;
+          }
+        return -1;
+      case 6:
+        switch (key[0])
+          {
+           case 'K':
+             if (!memcmp(key, "KP_End", 6)) return 10;
+             return -1;
+          }
+        return -1;
+      case 7:
+        switch (key[3])
+          {
+           case 'D':
+             if (!memcmp(key, "KP_Down", 7)) return 1;
+             return -1;
+           case 'L':
+             if (!memcmp(key, "KP_Left", 7)) return 3;
+             return -1;
+           case 'H':
+             if (!memcmp(key, "KP_Home", 7)) return 6;
+             return -1;
+           case 'N':
+             if (!memcmp(key, "KP_Next", 7)) return 8;
+             return -1;
+          }
+        return -1;
+      case 8:
+        switch (key[3])
+          {
+           case 'R':
+             if (!memcmp(key, "KP_Right", 8)) return 2;
+             return -1;
+           case 'P':
+             if (!memcmp(key, "KP_Prior", 8)) return 7;
+             return -1;
+           case 'B':
+             if (!memcmp(key, "KP_Begin", 8)) return 9;
+             return -1;
+          }
+        return -1;
+      case 9:
+        switch (key[3])
+          {
+           case 'I':
+             if (!memcmp(key, "KP_Insert", 9)) return 4;
+             return -1;
+           case 'D':
+             if (!memcmp(key, "KP_Delete", 9)) return 5;
+             return -1;
+          }
+        return -1;
+     }
+   return -1;
+}
@@ -450,6 +450,45 @@ _solo_new(Term *term, Win *wn)
 /* }}} */
 /* {{{ Win */
 
+/* tells every terminal of the window whether it can be seen, so that the
+ * ones in hidden tabs or in an iconified window do not draw anything */
+static void
+_win_terms_visible_update(Win *wn)
+{
+   Eina_List *l;
+   Term *term;
+   Eina_Bool shown;
+
+   shown = (!elm_win_iconified_get(wn->win)) &&
+           (!elm_win_withdrawn_get(wn->win));
+   EINA_LIST_FOREACH(wn->terms, l, term)
+     {
+        Term_Container *tc;
+        Eina_Bool visible = shown;
+
+        for (tc = term->container; (visible) && (tc) && (tc->parent);
+             tc = tc->parent)
+          {
+             Tabs *tabs;
+
+             if (tc->parent->type != TERM_CONTAINER_TYPE_TABS) continue;
+             tabs = (Tabs*) tc->parent;
+             /* all the tabs are shown by the selector */
+             if ((!tabs->selector) && (tabs->current) &&
+                 (tabs->current->tc != tc))
+               visible = EINA_FALSE;
+          }
+        termio_visible_set(term->termio, visible);
+     }
+}
+
+static void
+_cb_win_visibility(void *data,
+                   Evas_Object *obj EINA_UNUSED, void *event EINA_UNUSED)
+{
+   _win_terms_visible_update(data);
+}
+
 static void
 _cb_win_focus_in(void *data,
                  Evas_Object *obj EINA_UNUSED, void *event EINA_UNUSED)
@@ -668,6 +707,9 @@ win_free(Win *wn)
      {
         evas_object_smart_callback_del_full(wn->win, "focus,in", _cb_win_focus_in, wn);
         evas_object_smart_callback_del_full(wn->win, "focus,out", _cb_win_focus_out, wn);
+        evas_object_smart_callback_del_full(wn->win, "iconified", _cb_win_visibility, wn);
+        evas_object_smart_callback_del_full(wn->win, "withdrawn", _cb_win_visibility, wn);
+        evas_object_smart_callback_del_full(wn->win, "normal", _cb_win_visibility, wn);
         evas_object_event_callback_del_full(wn->win, EVAS_CALLBACK_DEL, _cb_del, wn);
         evas_object_del(wn->win);
      }
@@ -1059,6 +1101,9 @@ win_new(const char *name, const char *role, const char *title,
 
    evas_object_smart_callback_add(wn->win, "focus,in", _cb_win_focus_in, wn);
    evas_object_smart_callback_add(wn->win, "focus,out", _cb_win_focus_out, wn);
+   evas_object_smart_callback_add(wn->win, "iconified", _cb_win_visibility, wn);
+   evas_object_smart_callback_add(wn->win, "withdrawn", _cb_win_visibility, wn);
+   evas_object_smart_callback_add(wn->win, "normal", _cb_win_visibility, wn);
 
    wins = eina_list_append(wins, wn);
    return wn;
@@ -1953,6 +1998,7 @@ _cb_tab_selector_show(Tabs *tabs, Tab_Item *to_item)
                                   _tabs_selector_cb_exit, tabs);
    evas_object_smart_callback_add(tabs->selector, "ending",
                                   _tabs_selector_cb_ending, tabs);
+   _win_terms_visible_update(wn);
    z = 1.0;
    sel_go(tabs->selector);
    count = eina_list_count(tabs->tabs);
@@ -2520,6 +2566,7 @@ _tabs_refresh(Tabs *tabs)
 
    if (n <= 0)
      return;
+   _win_terms_visible_update(tabs->tc.wn);
 
    buf[0] = '\0';
    EINA_LIST_FOREACH(tabs->tabs, l, tab_item)
@@ -3439,7 +3486,11 @@ _cb_cmd_aborted(void *data,
    edje_object_signal_emit(wn->base, "cmdbox,hide", "terminology");
    tc = (Term_Container*) wn;
    term = tc->focused_term_get(tc);
-   if (term) elm_object_focus_set(term->termio, EINA_TRUE);
+   if (term)
+     {
+        termio_search_clear(term->termio);
+        elm_object_focus_set(term->termio, EINA_TRUE);
+     }
    if (wn->cmdbox_focus_timer)
      {
         ecore_timer_del(wn->cmdbox_focus_timer);
@@ -0,0 +1,241 @@
+/* Feeds files to a terminal without a window nor a pty, through the
+ * escape parser and termpty_text_save_top() as if a program had printed
+ * them, and prints how many bytes the rows scrolled into the backlog
+ * take, packed and unpacked, and how long it took.  Rows still on the
+ * screen at the end are not counted.
+ *
+ * usage, from a configured tree:
+ *   cc -O2 -DHAVE_CONFIG_H -I. -Isrc/bin -o backlog_bench \
+ *      tools/backlog_bench.c src/bin/col.c src/bin/termpty.c \
+ *      src/bin/termptydbl.c src/bin/termptyesc.c src/bin/termptyext.c \
+ *      src/bin/termptygfx.c src/bin/termptylatency.c src/bin/termptyops.c \
+ *      src/bin/termptysave.c src/bin/utf8.c src/bin/lz4/lz4.c \
+ *      $(pkg-config --cflags --libs elementary)
+ *   ./backlog_bench [-w COLUMNS] [-h ROWS] [-b BACKLOG_ROWS] FILE...
+ */
+
+#include "private.h"
+#include <Elementary.h>
+#include <getopt.h>
+#include "config.h"
+#include "termio.h"
+#include "termpty.h"
+#include "termptyesc.h"
+#include "termptyops.h"
+#include "termptysave.h"
+
+/* as read from the pty at once, see _cb_fd_read() */
+#define FEED_CHUNK 4096
+
+int _log_domain = -1;
+
+static Config _config;
+
+/* {{{ What the terminal calls termio.c for, without a window */
+
+Config *
+termio_config_get(const Evas_Object *obj EINA_UNUSED)
+{
+   return &_config;
+}
+
+void
+termio_content_change(Evas_Object *obj EINA_UNUSED,
+                      Evas_Coord x EINA_UNUSED, Evas_Coord y EINA_UNUSED,
+                      int n EINA_UNUSED)
+{
+}
+
+void
+termio_scroll(Evas_Object *obj EINA_UNUSED, int direction EINA_UNUSED,
+              int start_y EINA_UNUSED, int end_y EINA_UNUSED)
+{
+}
+
+Evas_Object *
+termio_textgrid_get(Evas_Object *obj EINA_UNUSED)
+{
+   return NULL;
+}
+
+/* }}} */
+
+/* what termpty_new() sets up, short of the pty and the child */
+static Termpty *
+_pty_new(int w, int h, int backsize)
+{
+   Termpty *ty;
+
+   ty = calloc(1, sizeof(Termpty));
+   if (!ty) return NULL;
+   eina_lock_new(&ty->backlock.lock);
+   ty->w = w;
+   ty->h = h;
+   ty->backsize = backsize;
+   ty->fd = -1;
+   ty->slavefd = -1;
+   ty->pid = -1;
+   termpty_reset_state(ty);
+   ty->screen = calloc(1, sizeof(Termcell) * ty->w * ty->h);
+   ty->screen2 = calloc(1, sizeof(Termcell) * ty->w * ty->h);
+   if ((!ty->screen) || (!ty->screen2) || (!ty->back))
+     {
+        termpty_free(ty);
+        return NULL;
+     }
+   termpty_save_register(ty);
+   return ty;
+}
+
+/* the bytes of buf as codepoints, a nul byte being one too */
+static Eina_Unicode *
+_decode(const char *buf, int len, int *np)
+{
+   Eina_Unicode *cps;
+   int i = 0, n = 0;
+
+   cps = malloc((len + 1) * sizeof(Eina_Unicode));
+   if (!cps) return NULL;
+   while (i < len)
+     {
+        if (buf[i]) cps[n++] = eina_unicode_utf8_next_get(buf, &i);
+        else
+          {
+             cps[n++] = 0;
+             i++;
+          }
+     }
+   cps[n] = 0;
+   *np = n;
+   return cps;
+}
+
+/* hands cps to the parser FEED_CHUNK at a time, as _handle_buf() does,
+ * giving it more when a sequence is cut */
+static void
+_feed(Termpty *ty, Eina_Unicode *cps, int n)
+{
+   Eina_Unicode *c = cps, *end = cps + n;
+
+   while (c < end)
+     {
+        Eina_Unicode *ce = c + FEED_CHUNK;
+        int k;
+
+        if (ce > end) ce = end;
+        while (c < ce)
+          {
+             k = termpty_handle_seq(ty, c, ce);
+             if (k > 0)
+               {
+                  c += k;
+                  continue;
+               }
+             if (ce == end) return;
+             ce += FEED_CHUNK;
+             if (ce > end) ce = end;
+          }
+     }
+}
+
+static Eina_Bool
+_bench(const char *path, int w, int h, int backsize)
+{
+   FILE *f;
+   Termpty *ty;
+   Eina_Unicode *cps;
+   char *buf;
+   size_t len, i, rows = 0, packed = 0, plain = 0, bytes;
+   long size;
+   double t;
+   int n = 0;
+
+   f = fopen(path, "rb");
+   if ((!f) || (fseek(f, 0, SEEK_END) != 0) || ((size = ftell(f)) < 0))
+     {
+        fprintf(stderr, "%s: cannot open\n", path);
+        if (f) fclose(f);
+        return EINA_FALSE;
+     }
+   len = size;
+   rewind(f);
+   buf = malloc(len + 1);
+   if ((!buf) || (fread(buf, 1, len, f) != len))
+     {
+        fprintf(stderr, "%s: cannot read\n", path);
+        free(buf);
+        fclose(f);
+        return EINA_FALSE;
+     }
+   buf[len] = '\0';
+   fclose(f);
+
+   ty = _pty_new(w, h, backsize);
+   if (!ty)
+     {
+        free(buf);
+        return EINA_FALSE;
+     }
+   t = ecore_time_get();
+   cps = _decode(buf, len, &n);
+   if (cps) _feed(ty, cps, n);
+   t = ecore_time_get() - t;
+   free(cps);
+   free(buf);
+
+   termpty_backlog_lock(ty);
+   for (i = 0; i < ty->backsize; i++)
+     {
+        const Termsave *ts = &ty->back[i];
+
+        if (!ts->cells) continue;
+        rows++;
+        if (ts->comp) packed++;
+        plain += ts->w * sizeof(Termcell);
+     }
+   bytes = termpty_save_usage_get(ty);
+   termpty_backlog_unlock(ty);
+   if (rows > 0)
+     printf("%s: %zu rows, %zu bytes per row (%zu unpacked), "
+            "%.1f%% packed, %.3fs, %.1fMB/s\n",
+            path, rows, bytes / rows, plain / rows,
+            (100.0 * packed) / rows, t,
+            (t > 0.0) ? (len / t) / (1024 * 1024) : 0.0);
+   else
+     printf("%s: nothing went to the backlog, %.3fs\n", path, t);
+   termpty_free(ty);
+   return EINA_TRUE;
+}
+
+int
+main(int argc, char **argv)
+{
+   int w = 80, h = 24, backsize = 1000000, opt, ret = 0;
+   Eina_Bool bad = EINA_FALSE;
+
+   while ((opt = getopt(argc, argv, "w:h:b:")) != -1)
+     {
+        switch (opt)
+          {
+           case 'w': w = atoi(optarg); break;
+           case 'h': h = atoi(optarg); break;
+           case 'b': backsize = atoi(optarg); break;
+           default: bad = EINA_TRUE; break;
+          }
+     }
+   if ((bad) || (optind >= argc) || (w <= 0) || (h <= 0) || (backsize <= 0))
+     {
+        fprintf(stderr, "usage: %s [-w COLUMNS] [-h ROWS] "
+                "[-b BACKLOG_ROWS] FILE...\n", argv[0]);
+        return 1;
+     }
+   eina_init();
+   ecore_init();
+   termpty_init();
+   for (; optind < argc; optind++)
+     if (!_bench(argv[optind], w, h, backsize)) ret = 1;
+   termpty_shutdown();
+   ecore_shutdown();
+   eina_shutdown();
+   return ret;
+}
@@ -98,10 +98,63 @@ do_key() {
    fi
 }
 
+# prints a C function returning the index in the table of a key of
+# length len, or -1: it switches on the length, then on the character
+# that tells most keys of that length apart
+do_index() {
+   local name="$1"
+   shift
+   echo "$@" | tr ' ' '\n' | grep -v '^$' | awk -v name="$name" '
+   { key[NR - 1] = $0; n = NR; if (length($0) > max) max = length($0) }
+   END {
+      printf("static int\n%s(const char *key, int len)\n{\n", name)
+      printf("   switch (len)\n     {\n")
+      for (len = 1; len <= max; len++)
+        {
+           best = 0; bestn = 0
+           for (p = 1; p <= len; p++)
+             {
+                split("", seen); c = 0
+                for (i = 0; i < n; i++)
+                  if (length(key[i]) == len)
+                    {
+                       ch = substr(key[i], p, 1)
+                       if (!(ch in seen)) { seen[ch] = 1; c++ }
+                    }
+                if (c > bestn) { bestn = c; best = p }
+             }
+           if (best == 0) continue
+           printf("      case %d:\n", len)
+           printf("        switch (key[%d])\n          {\n", best - 1)
+           split("", cases); nc = 0
+           for (i = 0; i < n; i++)
+             {
+                if (length(key[i]) != len) continue
+                ch = substr(key[i], best, 1)
+                if (!(ch in cases)) order[nc++] = ch
+                cases[ch] = cases[ch] " " i
+             }
+           for (c = 0; c < nc; c++)
+             {
+                ch = order[c]
+                printf("           case \047%s\047:\n", ch)
+                k = split(substr(cases[ch], 2), idx, " ")
+                for (j = 1; j <= k; j++)
+                  printf("             if (!memcmp(key, \"%s\", %d)) return %d;\n",
+                         key[idx[j]], len, idx[j])
+                printf("             return -1;\n")
+             }
+           printf("          }\n        return -1;\n")
+        }
+      printf("     }\n   return -1;\n}\n")
+   }'
+}
+
 do_keys_mode() {
 
 
-   local keys='F1 F2 F3 F4 F5 F6 F7 F8 F9 F10 F11 F12 Left Right Up Down Home End Insert Delete Prior Next Tab minus space Menu Find Help Select '
+   local keys='F1 F2 F3 F4 F5 F6 F7 F8 F9 F10 F11 F12 Left Right Up Down Home End Insert Delete Prior Next ISO_Left_Tab Tab minus underscore space Menu Find Help Execute Select '
+   local kp_keys='KP_Up KP_Down KP_Right KP_Left KP_Insert KP_Delete KP_Home KP_Prior KP_Next KP_Begin KP_End'
 
    echo "#define KH(in) { in, sizeof(in) - 1 }"
 
@@ -143,10 +196,8 @@ do_keys_mode() {
 
    # Kp_*
 
-   keys='KP_Up KP_Down KP_Right KP_Left KP_Insert KP_Delete KP_Home KP_Prior KP_Next KP_Begin KP_End'
-
    echo "static const Tty_Key tty_keys_kp_plain[] = {"
-   for k in $keys; do
+   for k in $kp_keys; do
       echo "{"
       echo "  \"$k\","
       echo "  sizeof(\"$k\") - 1,"
@@ -180,7 +231,7 @@ do_keys_mode() {
    done
    echo "};"
    echo "static const Tty_Key tty_keys_kp_app[] = {"
-   for k in $keys; do
+   for k in $kp_keys; do
       echo "{"
       echo "  \"$k\","
       echo "  sizeof(\"$k\") - 1,"
@@ -238,6 +289,9 @@ do_keys_mode() {
    #do_one_cursor_and_keypad_mode
 
    echo "#undef KH"
+
+   do_index tty_keys_index $keys
+   do_index tty_keys_kp_index $kp_keys
 }
 
 cat <<END >&2
@@ -0,0 +1,176 @@
+/* Times how keys sent to the pty are found in the tables of tty_keys.h:
+ * the linear scan keyin.c used to do, and tty_keys_index() /
+ * tty_keys_kp_index() followed by the pick of the modifier variant done
+ * by _key_try().  Every key name of the tables is looked up, along with
+ * names found in none of them, with every combination of modifiers.
+ *
+ * usage: cc -O2 -Isrc/bin -o key_lookup_bench tools/key_lookup_bench.c
+ *        ./key_lookup_bench [ROUNDS]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+
+typedef struct _Tty_Key Tty_Key;
+
+/* as in keyin.c */
+struct _s {
+    char *s;
+    ssize_t len;
+};
+
+typedef struct _s Key_Values[8];
+
+struct _Tty_Key
+{
+    char *key;
+    int key_len;
+    Key_Values default_mode;
+    Key_Values cursor;
+};
+
+#include "tty_keys.h"
+
+#define COUNT(_a) ((int)(sizeof(_a) / sizeof((_a)[0])))
+
+typedef struct _Table Table;
+
+struct _Table
+{
+   const char *name;
+   const Tty_Key *keys;
+   int n;
+   int (*index)(const char *key, int len);
+};
+
+static const Table _tables[] =
+{
+   { "tty_keys", tty_keys, COUNT(tty_keys), tty_keys_index },
+   { "tty_keys_kp_plain", tty_keys_kp_plain, COUNT(tty_keys_kp_plain),
+     tty_keys_kp_index },
+   { "tty_keys_kp_app", tty_keys_kp_app, COUNT(tty_keys_kp_app),
+     tty_keys_kp_index },
+};
+
+/* names of keys found in no table, such as letters */
+static const char *const _misses[] =
+{
+   "a", "z", "A", "Shift_L", "Control_R", "Num_Lock", "Escapes", "F0",
+   "KP_Foo", "eacute", "XF86AudioMute"
+};
+
+static size_t _written = 0;
+
+static double
+_now(void)
+{
+   struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+/* what _key_try() does, short of writing to a pty */
+static void
+_key_try(const Tty_Key *key, int appcursor, int alt, int shift, int ctrl)
+{
+   const struct _s *kv, *s;
+
+   if (!appcursor) kv = key->default_mode;
+   else            kv = key->cursor;
+   s = &kv[(!!alt) | ((!!ctrl) << 1) | ((!!shift) << 2)];
+   if (s->len > 0) _written += s->len;
+}
+
+/* what keyin.c did before the tables got indexed */
+static int
+_scan_index(const Table *t, const char *key, int len)
+{
+   int i;
+
+   for (i = 0; i < t->n; i++)
+     if ((len == t->keys[i].key_len) && (!memcmp(key, t->keys[i].key, len)))
+       return i;
+   return -1;
+}
+
+static double
+_run(const Table *t, const char *const *names, int n, int rounds,
+     int scan)
+{
+   double start = _now();
+   int r, i, mods;
+
+   for (r = 0; r < rounds; r++)
+     for (i = 0; i < n; i++)
+       for (mods = 0; mods < 16; mods++)
+         {
+            const char *key = names[i];
+            int len = strlen(key), k;
+
+            if (scan) k = _scan_index(t, key, len);
+            else k = t->index(key, len);
+            if (k >= 0)
+              _key_try(&t->keys[k], mods & 8, mods & 1, mods & 4, mods & 2);
+         }
+   return _now() - start;
+}
+
+int
+main(int argc, char **argv)
+{
+   int rounds = (argc > 1) ? atoi(argv[1]) : 2000;
+   int i, k;
+
+   if (rounds <= 0)
+     {
+        fprintf(stderr, "usage: %s [ROUNDS]\n", argv[0]);
+        return 1;
+     }
+   for (i = 0; i < COUNT(_tables); i++)
+     {
+        const Table *t = &_tables[i];
+        const char **names;
+        int n = t->n + COUNT(_misses);
+        double scan, index;
+        long lookups;
+
+        names = malloc(n * sizeof(const char *));
+        if (!names) return 1;
+        for (k = 0; k < t->n; k++)
+          {
+             names[k] = t->keys[k].key;
+             /* the index has to agree with the table */
+             if (t->index(t->keys[k].key, t->keys[k].key_len) != k)
+               {
+                  fprintf(stderr, "%s: %s found at %i instead of %i\n",
+                          t->name, t->keys[k].key,
+                          t->index(t->keys[k].key, t->keys[k].key_len), k);
+                  return 1;
+               }
+          }
+        for (k = 0; k < COUNT(_misses); k++)
+          {
+             names[t->n + k] = _misses[k];
+             if (t->index(_misses[k], strlen(_misses[k])) >= 0)
+               {
+                  fprintf(stderr, "%s: %s found\n", t->name, _misses[k]);
+                  return 1;
+               }
+          }
+        lookups = (long)rounds * n * 16;
+        scan = _run(t, names, n, rounds, 1);
+        index = _run(t, names, n, rounds, 0);
+        printf("%s: %i keys, %li lookups, scan %.1fns, index %.1fns "
+               "per lookup\n", t->name, t->n, lookups,
+               scan * 1000000000.0 / lookups,
+               index * 1000000000.0 / lookups);
+        free(names);
+     }
+   /* keeps the lookups from being optimized away */
+   if (!_written) return 1;
+   return 0;
+}